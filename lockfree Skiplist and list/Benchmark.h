@@ -0,0 +1,399 @@
+// Throughput and latency benchmark for SkipList and List against
+// mutex-guarded std::map / std::priority_queue baselines. main.cpp runs it
+// with --bench, see benchUsage() for the options.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Skiplist.h"
+#include "MultiQueue.h"
+#include "List.h"
+
+enum class KeyDist { Uniform, Zipf, Monotonic };
+
+inline const char* keyDistName(KeyDist d) {
+	switch (d) {
+	case KeyDist::Uniform: return "uniform";
+	case KeyDist::Zipf: return "zipf";
+	default: return "monotonic";
+	}
+}
+
+// Relative weight of each operation (they need not add up to 100).
+struct OpMix {
+	std::string name;
+	int add = 0, remove = 0, contains = 0, get = 0, popMin = 0;
+
+	int total() const { return add + remove + contains + get + popMin; }
+	bool pointOps() const { return remove + contains + get != 0; }
+	std::string describe() const {
+		std::ostringstream s;
+		s << name << " (" << add << "/" << remove << "/" << contains << "/" << get << "/" << popMin << ")";
+		return s.str();
+	}
+};
+
+struct BenchConfig {
+	std::vector<int> threads;
+	uint64_t keyRange = 1 << 16;
+	uint64_t listKeyRange = 1 << 10; // List is O(n) per op
+	size_t opsPerThread = 200000;
+	std::vector<OpMix> mixes;
+	std::vector<KeyDist> dists;
+	double zipfTheta = 0.99;         // 0 < theta < 1
+	int latencySample = 16;          // time one op in this many
+	std::vector<std::string> only;   // structures to run, all when empty
+};
+
+// Per-thread key source. Zipf is Gray et al.'s generator (as in YCSB) with
+// the ranks scattered over the key range, so hot keys are not all at the
+// front. Monotonic keys increase per thread from the end of the range,
+// interleaved across threads, and the non-add operations aim at one of
+// the thread's last 64 keys.
+class KeyGenerator {
+public:
+	struct Zipf {
+		uint64_t n;
+		double theta, alpha, zetan, eta;
+		Zipf(uint64_t n, double theta) : n(n), theta(theta) {
+			double zeta2 = 1.0 + std::pow(0.5, theta);
+			zetan = 0;
+			for (uint64_t i = 1; i <= n; ++i)
+				zetan += 1.0 / std::pow(double(i), theta);
+			alpha = 1.0 / (1.0 - theta);
+			eta = (1.0 - std::pow(2.0 / double(n), 1.0 - theta)) / (1.0 - zeta2 / zetan);
+		}
+	};
+
+	KeyGenerator(KeyDist dist, uint64_t range, const Zipf* zipf, int tid, int threadCount)
+		: dist(dist), range(range), zipf(zipf), tid(tid), threadCount(threadCount), state(0x9E3779B97F4A7C15ull * (tid + 1) | 1) {
+		while (scatterBits < 64 && (1ull << scatterBits) < range)
+			++scatterBits;
+	}
+
+	uint64_t next(bool isAdd) {
+		switch (dist) {
+		case KeyDist::Uniform:
+			return random() % range;
+		case KeyDist::Zipf:
+			return scatter(zipfRank());
+		default:
+			if (isAdd)
+				return range + (sequence++) * threadCount + tid;
+			if (sequence == 0)
+				return range + tid;
+			return range + (sequence - 1 - random() % std::min<uint64_t>(sequence, 64)) * threadCount + tid;
+		}
+	}
+	uint64_t random() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1Dull;
+	}
+
+private:
+	uint64_t zipfRank() {
+		double u = double(random() >> 11) * (1.0 / 9007199254740992.0);
+		double uz = u * zipf->zetan;
+		if (uz < 1.0) return 0;
+		if (uz < 1.0 + std::pow(0.5, zipf->theta)) return 1;
+		uint64_t rank = uint64_t(double(zipf->n) * std::pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+		return rank < zipf->n ? rank : zipf->n - 1;
+	}
+	// A permutation of [0, range): an odd multiply and an xorshift are both
+	// one-to-one on scatterBits bits, and walking the cycle until the value
+	// is back in range keeps that for any range (under 2 steps on average).
+	// A plain % range would merge ranks unless range is a power of two.
+	uint64_t scatter(uint64_t rank) const {
+		uint64_t mask = scatterBits < 64 ? (1ull << scatterBits) - 1 : ~0ull;
+		do {
+			rank = rank * 0x9E3779B97F4A7C15ull & mask;
+			rank ^= rank >> (scatterBits + 1) / 2;
+		} while (rank >= range);
+		return rank;
+	}
+
+	KeyDist dist;
+	uint64_t range;
+	const Zipf* zipf;
+	uint64_t tid;
+	uint64_t threadCount;
+	uint64_t state;
+	uint64_t sequence = 0;
+	int scatterBits = 0; // of the smallest power of two >= range
+};
+
+// One interface over everything measured. popMin and the point operations
+// return whether they found something; unsupported ones are never called.
+template <typename Queue>
+struct LockFreeBench {
+	static constexpr bool POINT_OPS = true;
+	Queue q;
+	bool add(uint64_t k) { return q.add(k, int(k)); }
+	bool remove(uint64_t k) { return q.remove(k); }
+	bool contains(uint64_t k) { return q.contains(k); }
+	bool get(uint64_t k) { return q.get(k).has_value(); }
+	bool popMin() { return q.popMin().has_value(); }
+};
+
+// List has no popMin: remove the first key the iterator sees.
+template <typename L>
+struct ListBench {
+	static constexpr bool POINT_OPS = true;
+	L q;
+	bool add(uint64_t k) { return q.add(k, int(k)); }
+	bool remove(uint64_t k) { return q.remove(k); }
+	bool contains(uint64_t k) { return q.contains(k); }
+	bool get(uint64_t k) { return q.get(k).has_value(); }
+	bool popMin() {
+		while (true) {
+			uint64_t first;
+			{
+				auto it = q.iterator();
+				if (!it.valid())
+					return false;
+				first = it.key();
+			}
+			if (q.remove(first))
+				return true;
+		}
+	}
+};
+
+struct LockedMapBench {
+	static constexpr bool POINT_OPS = true;
+	std::mutex m;
+	std::map<uint64_t, int> map;
+	bool add(uint64_t k) { std::lock_guard<std::mutex> lock(m); return map.emplace(k, int(k)).second; }
+	bool remove(uint64_t k) { std::lock_guard<std::mutex> lock(m); return map.erase(k) != 0; }
+	bool contains(uint64_t k) { std::lock_guard<std::mutex> lock(m); return map.count(k) != 0; }
+	bool get(uint64_t k) {
+		std::lock_guard<std::mutex> lock(m);
+		auto it = map.find(k);
+		return it != map.end();
+	}
+	bool popMin() {
+		std::lock_guard<std::mutex> lock(m);
+		if (map.empty())
+			return false;
+		map.erase(map.begin());
+		return true;
+	}
+};
+
+// add/popMin only; duplicates are kept, as a heap does.
+struct LockedHeapBench {
+	static constexpr bool POINT_OPS = false;
+	std::mutex m;
+	std::priority_queue<std::pair<uint64_t, int>, std::vector<std::pair<uint64_t, int>>, std::greater<>> heap;
+	bool add(uint64_t k) { std::lock_guard<std::mutex> lock(m); heap.emplace(k, int(k)); return true; }
+	bool remove(uint64_t) { return false; }
+	bool contains(uint64_t) { return false; }
+	bool get(uint64_t) { return false; }
+	bool popMin() {
+		std::lock_guard<std::mutex> lock(m);
+		if (heap.empty())
+			return false;
+		heap.pop();
+		return true;
+	}
+};
+
+struct BenchResult {
+	double mops = 0;
+	uint64_t p50 = 0, p99 = 0, p999 = 0; // ns, over the sampled ops
+};
+
+// Runs one (structure, mix, distribution, thread count) point on a fresh
+// structure prefilled with range / 2 uniform random keys.
+template <typename Bench>
+BenchResult runBenchPoint(const BenchConfig& cfg, const OpMix& mix, KeyDist dist, const KeyGenerator::Zipf* zipf,
+	uint64_t range, int threadCount) {
+	using Clock = std::chrono::steady_clock;
+	Bench bench;
+	KeyGenerator fill(KeyDist::Uniform, range, nullptr, threadCount, threadCount + 1);
+	for (uint64_t i = 0; i < range / 2; ++i)
+		bench.add(fill.next(true));
+
+	std::vector<std::vector<uint32_t>> latencies(threadCount);
+	std::atomic<int> ready{ 0 };
+	std::atomic<bool> go{ false };
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&, t]() {
+			KeyGenerator keys(dist, range, zipf, t, threadCount);
+			std::vector<uint32_t>& lat = latencies[t];
+			lat.reserve(cfg.opsPerThread / cfg.latencySample + 1);
+			const int total = mix.total();
+			ready++;
+			while (!go.load(std::memory_order_acquire)) {}
+			for (size_t i = 0; i < cfg.opsPerThread; ++i) {
+				int pick = int(keys.random() % uint64_t(total));
+				bool timed = i % cfg.latencySample == 0;
+				Clock::time_point start;
+				if (timed)
+					start = Clock::now();
+				if ((pick -= mix.add) < 0) bench.add(keys.next(true));
+				else if ((pick -= mix.remove) < 0) bench.remove(keys.next(false));
+				else if ((pick -= mix.contains) < 0) bench.contains(keys.next(false));
+				else if ((pick -= mix.get) < 0) bench.get(keys.next(false));
+				else bench.popMin();
+				if (timed) {
+					auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+					lat.push_back(uint32_t(std::min<long long>(ns, UINT32_MAX)));
+				}
+			}
+		});
+	}
+	while (ready.load() < threadCount) {}
+	auto start = Clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto& th : threads) th.join();
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<uint32_t> all;
+	for (auto& lat : latencies)
+		all.insert(all.end(), lat.begin(), lat.end());
+	std::sort(all.begin(), all.end());
+	BenchResult r;
+	r.mops = double(cfg.opsPerThread) * threadCount / seconds / 1e6;
+	if (!all.empty()) {
+		r.p50 = all[all.size() / 2];
+		r.p99 = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+		r.p999 = all[std::min(all.size() - 1, all.size() * 999 / 1000)];
+	}
+	return r;
+}
+
+// Scaling curve of one structure: every mix and distribution it supports,
+// at every thread count.
+template <typename Bench>
+void runBenchSeries(const BenchConfig& cfg, const char* name, uint64_t range) {
+	if (!cfg.only.empty() && std::find(cfg.only.begin(), cfg.only.end(), std::string(name)) == cfg.only.end())
+		return;
+	for (KeyDist dist : cfg.dists) {
+		KeyGenerator::Zipf zipf(dist == KeyDist::Zipf ? range : 2, cfg.zipfTheta);
+		for (const OpMix& mix : cfg.mixes) {
+			if (mix.pointOps() && !Bench::POINT_OPS)
+				continue;
+			std::cout << name << ", " << mix.describe() << ", " << keyDistName(dist) << ", " << range << " keys\n";
+			double base = 0;
+			for (int threadCount : cfg.threads) {
+				BenchResult r = runBenchPoint<Bench>(cfg, mix, dist, &zipf, range, threadCount);
+				if (base == 0)
+					base = r.mops / threadCount;
+				std::cout << "  " << std::setw(3) << threadCount << " threads: " << std::fixed << std::setprecision(2)
+					<< std::setw(8) << r.mops << " Mops/s (x" << r.mops / base << ")  p50 " << r.p50 << " ns  p99 "
+					<< r.p99 << " ns  p999 " << r.p999 << " ns\n" << std::defaultfloat;
+			}
+		}
+	}
+}
+
+inline const char* benchUsage() {
+	return "--bench [--threads 1,2,4] [--keys N] [--list-keys N] [--ops N per thread]\n"
+		"        [--mix name=add/remove/contains/get/popMin ...] [--dist uniform,zipf,monotonic]\n"
+		"        [--zipf theta] [--sample every-Nth-op] [--only skiplist,skiplist-hp,list,map,heap]\n";
+}
+
+// Parses the arguments after --bench; returns false on a bad one.
+inline bool parseBenchArgs(int argc, char** argv, BenchConfig& cfg) {
+	auto splitInts = [](const std::string& s) {
+		std::vector<int> out;
+		std::stringstream in(s);
+		std::string item;
+		while (std::getline(in, item, ','))
+			out.push_back(std::atoi(item.c_str()));
+		return out;
+	};
+	auto split = [](const std::string& s, char sep) {
+		std::vector<std::string> out;
+		std::stringstream in(s);
+		std::string item;
+		while (std::getline(in, item, sep))
+			out.push_back(item);
+		return out;
+	};
+	std::vector<OpMix> mixes;
+	for (int i = 0; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		std::string value = argv[++i];
+		if (arg == "--threads") cfg.threads = splitInts(value);
+		else if (arg == "--keys") cfg.keyRange = std::strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--list-keys") cfg.listKeyRange = std::strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--ops") cfg.opsPerThread = std::strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--zipf") cfg.zipfTheta = std::atof(value.c_str());
+		else if (arg == "--sample") cfg.latencySample = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--only") cfg.only = split(value, ',');
+		else if (arg == "--dist") {
+			cfg.dists.clear();
+			for (const std::string& d : split(value, ',')) {
+				if (d == "uniform") cfg.dists.push_back(KeyDist::Uniform);
+				else if (d == "zipf") cfg.dists.push_back(KeyDist::Zipf);
+				else if (d == "monotonic") cfg.dists.push_back(KeyDist::Monotonic);
+				else return false;
+			}
+		}
+		else if (arg == "--mix") {
+			std::vector<std::string> parts = split(value, '=');
+			std::vector<std::string> shares = split(parts.back(), '/');
+			if (shares.size() != 5)
+				return false;
+			OpMix mix;
+			mix.name = parts.size() > 1 ? parts[0] : "custom";
+			mix.add = std::atoi(shares[0].c_str());
+			mix.remove = std::atoi(shares[1].c_str());
+			mix.contains = std::atoi(shares[2].c_str());
+			mix.get = std::atoi(shares[3].c_str());
+			mix.popMin = std::atoi(shares[4].c_str());
+			if (mix.total() <= 0)
+				return false;
+			mixes.push_back(mix);
+		}
+		else return false;
+	}
+	if (!mixes.empty())
+		cfg.mixes = mixes;
+	return cfg.keyRange > 1 && cfg.listKeyRange > 1 && !cfg.threads.empty();
+}
+
+inline BenchConfig defaultBenchConfig() {
+	BenchConfig cfg;
+	int hw = int(std::max(1u, std::thread::hardware_concurrency()));
+	for (int t = 1; t < hw; t *= 2)
+		cfg.threads.push_back(t);
+	cfg.threads.push_back(hw);
+	cfg.mixes = {
+		{ "read-mostly", 5, 5, 80, 10, 0 },
+		{ "update-heavy", 50, 50, 0, 0, 0 },
+		{ "priority-queue", 50, 0, 0, 0, 50 },
+		{ "mixed", 20, 10, 30, 20, 20 },
+	};
+	cfg.dists = { KeyDist::Uniform, KeyDist::Zipf, KeyDist::Monotonic };
+	return cfg;
+}
+
+inline void runBenchmarks(const BenchConfig& cfg) {
+	runBenchSeries<LockFreeBench<SkipList<int, EpochManager>>>(cfg, "skiplist", cfg.keyRange);
+	runBenchSeries<LockFreeBench<SkipList<int, HazardPointerManager>>>(cfg, "skiplist-hp", cfg.keyRange);
+	runBenchSeries<LockFreeBench<MultiQueue<int, EpochManager>>>(cfg, "multiqueue", cfg.keyRange);
+	runBenchSeries<LockedMapBench>(cfg, "map", cfg.keyRange);
+	runBenchSeries<LockedHeapBench>(cfg, "heap", cfg.keyRange);
+	runBenchSeries<ListBench<List<int, EpochManager>>>(cfg, "list", cfg.listKeyRange);
+	runBenchSeries<LockedMapBench>(cfg, "map", cfg.listKeyRange);
+}
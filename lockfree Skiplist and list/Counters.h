@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include "Epochs.h"
+
+constexpr uint32_t COUNTER_STRIPES = 16;
+
+// Element count for SkipList and List kept in per-thread stripes, so add and
+// remove never share a cache line with other threads (up to COUNTER_STRIPES
+// of them). A thread picks its stripe from its reclaimer thread id.
+// read() sums the stripes without stopping anyone, so under concurrent
+// updates it is approximate: off by the updates in flight, never negative.
+class StripedCounter {
+	struct alignas(CACHE_LINE) Stripe {
+		std::atomic<int64_t> count{ 0 };
+	};
+	Stripe stripes[COUNTER_STRIPES];
+
+public:
+	void add(uint32_t tid, int64_t delta) {
+		stripes[tid % COUNTER_STRIPES].count.fetch_add(delta, std::memory_order_relaxed);
+	}
+	size_t read() const {
+		int64_t sum = 0;
+		for (const Stripe& s : stripes)
+			sum += s.count.load(std::memory_order_relaxed);
+		return sum > 0 ? size_t(sum) : 0;
+	}
+};
@@ -0,0 +1,147 @@
+// Elimination in front of SkipListMap for bursty producer/consumer phases.
+// An add whose key is smaller than every key in the list offers its item
+// in a slot for a moment: a popMin that comes by takes it from there, and
+// neither touches head->next[0]. Offers nobody takes go to the list as
+// usual.
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Skiplist.h"
+#include "Waiting.h"
+
+constexpr int ELIMINATION_SLOTS = 4;
+constexpr int ELIMINATION_SPINS = 128;      // waits for a consumer before withdrawing an offer
+constexpr int ELIMINATION_YIELDS = 2;       // then yields, so a consumer sharing the core gets a turn
+constexpr uint32_t ELIMINATION_MAX_SKIP = 64; // adds a thread skips offering after repeated misses
+
+// The exchange is linearizable: a popMin takes an offer only after seeing
+// its key below the list's first key, so add-then-popMin at that point
+// returns a minimum. The costs are a read of the first node on every add
+// (minKey) and up to ELIMINATION_SPINS waits and ELIMINATION_YIELDS
+// yields on an add of a new minimum; a thread whose offers keep timing
+// out skips offering for up to ELIMINATION_MAX_SKIP adds. Everything but
+// add and popMin goes straight to the list.
+template <typename K, typename T, typename Compare = std::less<K>, typename Reclaimer = EpochManager,
+	typename Alloc = HeapNodeAllocator, int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+class EliminationSkipListMap {
+	using Map = SkipListMap<K, T, Compare, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
+
+	// On the producer's stack; a consumer only reads it while it holds the
+	// claim on the slot.
+	struct Offer {
+		K key;
+		T value;
+		std::atomic<bool> taken{ false };
+	};
+	static constexpr uintptr_t CLAIMED = 1;
+	struct alignas(CACHE_LINE) Slot {
+		std::atomic<uintptr_t> word{ 0 }; // 0, an Offer*, or an Offer* | CLAIMED
+	};
+
+	Map map;
+	Compare comp;
+	Slot slots[ELIMINATION_SLOTS];
+
+public:
+	explicit EliminationSkipListMap(const Compare& comp = Compare()) : map(comp), comp(comp) {}
+
+	bool add(const K& key, T x) {
+		std::optional<K> first = map.minKey();
+		if ((!first || comp(key, *first)) && offer(key, x))
+			return true;
+		return map.add(key, std::move(x));
+	}
+	std::optional<T> popMin() {
+		if (std::optional<T> val = takeOffer())
+			return val;
+		return map.popMin();
+	}
+
+	bool remove(const K& key) { return map.remove(key); }
+	bool contains(const K& key) { return map.contains(key); }
+	std::optional<T> get(const K& key) { return map.get(key); }
+	std::optional<K> minKey() { return map.minKey(); }
+	size_t popMinBatch(std::vector<T>& out, size_t n) { return map.popMinBatch(out, n); }
+	void setRelaxedPopMin(int expectedThreads) { map.setRelaxedPopMin(expectedThreads); }
+	bool empty() { return map.empty(); }
+	size_t size() const { return map.size(); }
+	size_t exactSize() { return map.exactSize(); }
+	static StatsSnapshot stats() { return Map::stats(); }
+
+private:
+	// Publishes key and x in a free slot and waits for a consumer. On false
+	// the offer was withdrawn and x holds the item again.
+	bool offer(const K& key, T& x) {
+		static thread_local uint32_t skip = 0;
+		static thread_local uint32_t penalty = 0;
+		if (skip) {
+			--skip;
+			return false;
+		}
+		Offer o{ key, std::move(x) };
+		uintptr_t mine = reinterpret_cast<uintptr_t>(&o);
+		Slot& slot = slots[(threadRandom() >> 32) % ELIMINATION_SLOTS];
+		uintptr_t vacant = 0;
+		if (!slot.word.compare_exchange_strong(vacant, mine, std::memory_order_acq_rel)) {
+			x = std::move(o.value);
+			return false;
+		}
+		for (int spin = 0; spin < ELIMINATION_SPINS + ELIMINATION_YIELDS; ++spin) {
+			if (o.taken.load(std::memory_order_acquire)) {
+				penalty = 0;
+				return true;
+			}
+			if (spin < ELIMINATION_SPINS)
+				cpuRelax();
+			else
+				std::this_thread::yield();
+		}
+		while (true) {
+			uintptr_t expected = mine;
+			if (slot.word.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) {
+				penalty = penalty * 2 + 1 < ELIMINATION_MAX_SKIP ? penalty * 2 + 1 : ELIMINATION_MAX_SKIP;
+				skip = penalty;
+				x = std::move(o.value);
+				return false;
+			}
+			// claimed: the consumer either takes it or puts it back
+			if (o.taken.load(std::memory_order_acquire)) {
+				penalty = 0;
+				return true;
+			}
+			std::this_thread::yield(); // the claim holder may be descheduled
+		}
+	}
+
+	std::optional<T> takeOffer() {
+		size_t start = size_t(threadRandom() >> 32);
+		for (size_t i = 0; i < size_t(ELIMINATION_SLOTS); ++i) {
+			Slot& slot = slots[(start + i) % ELIMINATION_SLOTS];
+			uintptr_t w = slot.word.load(std::memory_order_acquire);
+			if (w == 0 || (w & CLAIMED))
+				continue;
+			if (!slot.word.compare_exchange_strong(w, w | CLAIMED, std::memory_order_acq_rel))
+				continue;
+			Offer* o = reinterpret_cast<Offer*>(w);
+			std::optional<K> first = map.minKey();
+			if (first && !comp(o->key, *first)) {
+				slot.word.store(w, std::memory_order_release); // a smaller key went in meanwhile
+				continue;
+			}
+			std::optional<T> val(std::move(o->value));
+			o->taken.store(true, std::memory_order_release); // o may be gone from here on
+			slot.word.store(0, std::memory_order_release);
+			Stats::count(STAT_ELIMINATED);
+			return val;
+		}
+		return std::nullopt;
+	}
+};
+
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator,
+	int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+using EliminationSkipList = EliminationSkipListMap<uint64_t, T, std::less<uint64_t>, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
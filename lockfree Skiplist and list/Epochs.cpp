@@ -1,4 +1,123 @@
 #include "Epochs.h"
+#include <stdexcept>
 namespace T_Threads {
-	thread_local size_t thread_id = 0;
-}
\ No newline at end of file
+	thread_local uint32_t thread_id = UNREGISTERED_THREAD;
+	thread_local uint32_t epoch_nesting = 0;
+}
+
+namespace {
+	// Per-thread retire lists. The destructor runs at thread exit and
+	// releases the slot of threads that never called unregisterThread().
+	struct RetireState {
+		std::vector<EpochManager::Retired> lists[RETIRE_LIST_COUNT];
+		size_t sinceCollect = 0;
+		~RetireState() {
+			if (T_Threads::thread_id != UNREGISTERED_THREAD)
+				EpochManager::instance().unregisterThread(T_Threads::thread_id);
+		}
+	};
+	thread_local RetireState retireState;
+}
+
+uint32_t EpochManager::registerThread(uint32_t preferred) {
+	if (T_Threads::thread_id != UNREGISTERED_THREAD)
+		return T_Threads::thread_id;
+
+	uint32_t id = UNREGISTERED_THREAD;
+	bool expected = false;
+	if (preferred < EPOCH_MAX_THREADS && slots_[preferred].inUse.compare_exchange_strong(expected, true))
+		id = preferred;
+	for (uint32_t i = 0; id == UNREGISTERED_THREAD && i < EPOCH_MAX_THREADS; ++i) {
+		expected = false;
+		if (slots_[i].inUse.compare_exchange_strong(expected, true))
+			id = i;
+	}
+	if (id == UNREGISTERED_THREAD)
+		throw std::runtime_error("EpochManager: no free thread slot");
+
+	uint32_t high = slotHighWater_.load(std::memory_order_relaxed);
+	while (high <= id && !slotHighWater_.compare_exchange_weak(high, id + 1)) {}
+
+	retireState.sinceCollect = 0; // touch the thread_local so its destructor runs at exit
+	T_Threads::thread_id = id;
+	return id;
+}
+
+void EpochManager::unregisterThread(uint32_t) {
+	// the slot is whatever this thread registered with, not the caller's hint
+	uint32_t id = T_Threads::thread_id;
+	if (id == UNREGISTERED_THREAD)
+		return;
+
+	collect();
+	{
+		std::lock_guard<std::mutex> lock(orphanMutex_);
+		for (auto& list : retireState.lists) {
+			orphans_.insert(orphans_.end(), list.begin(), list.end());
+			list.clear();
+		}
+	}
+	T_Threads::epoch_nesting = 0;
+	slots_[id].epoch.store(EPOCH_QUIESCENT, std::memory_order_release);
+	slots_[id].inUse.store(false, std::memory_order_release);
+	T_Threads::thread_id = UNREGISTERED_THREAD;
+}
+
+void EpochManager::retire(RetireList list, const Retired& r) {
+	threadId();
+	retireState.lists[list].push_back(r);
+	if (++retireState.sinceCollect >= RECLAIM_BATCH) {
+		retireState.sinceCollect = 0;
+		collect();
+	}
+}
+
+bool EpochManager::tryAdvance() {
+	uint64_t global = globalEpoch_.load(std::memory_order_seq_cst);
+
+	uint32_t count = slotHighWater_.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint64_t e = slots_[i].epoch.load(std::memory_order_seq_cst);
+		if (e != EPOCH_QUIESCENT && e != global)
+			return false; // someone is still pinned in an older epoch
+	}
+	return globalEpoch_.compare_exchange_strong(global, global + 1, std::memory_order_seq_cst);
+}
+
+size_t EpochManager::reclaimSafe(std::vector<Retired>& list, uint64_t global) {
+	size_t kept = 0;
+	size_t freed = 0;
+	for (size_t i = 0; i < list.size(); ++i) {
+		if (list[i].epoch + 2 <= global) {
+			list[i].reclaim(list[i].ptr);
+			++freed;
+		}
+		else {
+			list[kept++] = list[i];
+		}
+	}
+	list.resize(kept);
+	return freed;
+}
+
+size_t EpochManager::collect() {
+	tryAdvance();
+	uint64_t global = currentEpoch();
+
+	size_t freed = 0;
+	for (auto& list : retireState.lists)
+		freed += reclaimSafe(list, global);
+
+	if (orphanMutex_.try_lock()) {
+		freed += reclaimSafe(orphans_, global);
+		orphanMutex_.unlock();
+	}
+	return freed;
+}
+
+EpochManager::~EpochManager() {
+	// process teardown: no thread can hold a reference any more
+	for (auto& r : orphans_)
+		r.reclaim(r.ptr);
+	orphans_.clear();
+}
@@ -1,36 +1,180 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <atomic>
-const int thread_id = 0;
+#include <vector>
+#include <mutex>
+
+constexpr size_t CACHE_LINE = 64;
+
+// Order of the link loads that searches follow from node to node, in
+// Skiplist.h and List.h. Acquire by default. Defining
+// LOCKFREE_DEPENDENCY_ORDERED_LOADS makes them relaxed and relies on the
+// address dependency from a link to the node it points to instead, as the
+// Linux kernel's rcu_dereference does: every CPU but the Alpha keeps such
+// loads in order, and on ARM it turns each hop's LDAR into a plain LDR.
+// It is outside the C++ memory model, though: the compiler may in
+// principle break the dependency, and TSan reports the node reads as
+// races. Hazard pointer validation and the CASes keep their orders.
+#ifdef LOCKFREE_DEPENDENCY_ORDERED_LOADS
+constexpr std::memory_order LINK_LOAD_ORDER = std::memory_order_relaxed;
+#else
+constexpr std::memory_order LINK_LOAD_ORDER = std::memory_order_acquire;
+#endif
+
+constexpr uint32_t EPOCH_MAX_THREADS = 256;
+constexpr uint32_t UNREGISTERED_THREAD = UINT32_MAX;
+
+namespace T_Threads {
+	// Epoch slot owned by the calling thread, UNREGISTERED_THREAD until the
+	// thread registers (explicitly or on its first critical section).
+	extern thread_local uint32_t thread_id;
+	// Critical-section depth, so find() inside add() does not leave early.
+	extern thread_local uint32_t epoch_nesting;
+}
+
+// Retire lists are split by what they hold so a backend can batch per kind.
+enum RetireList { RETIRE_SNODE, RETIRE_LNODE, RETIRE_OTHER, RETIRE_LIST_COUNT };
+
+struct RetiredPtr {
+	void* ptr;
+	void (*reclaim)(void*);
+	uint64_t epoch; // epoch of retirement, unused by hazard pointers
+};
+
+template<typename T>
+void deleteRetired(void* p) { delete static_cast<T*>(p); }
+
+class EpochGuard;
+
+// Epoch-based reclamation.
+// Every thread owns a cache-line sized slot announcing the global epoch it
+// saw on entry (or EPOCH_QUIESCENT outside a critical section). Retired
+// pointers go to per-thread lists tagged with the epoch they were retired
+// in; once every active thread has caught up with the global epoch it is
+// bumped, and anything retired two epochs ago can no longer be referenced
+// and is freed in a batch.
+//
+// A pointer is only safe to use inside the critical section it was read
+// in. If you expect to keep a value for a long time make a deep copy of it,
+// otherwise it gets deleted once its epoch is safe.
 class EpochManager {
 public:
+	static constexpr uint64_t EPOCH_QUIESCENT = UINT64_MAX;
+	// retirements between attempts to advance the epoch and free a batch
+	static constexpr size_t RECLAIM_BATCH = 64;
+
+	using Retired = RetiredPtr;
+	using Guard = EpochGuard;
+	// Readers may step through marked nodes: nothing they can reach is
+	// freed while they are pinned.
+	static constexpr bool TRAVERSE_MARKED = true;
+
 	static EpochManager& instance() {
 		static EpochManager inst;
 		return inst;
 	}
 
-	// No-op stubs  real impl needed for production
-	// see T_Threads taskscheduler project for full implementation detail
-	// this is jsut a more portable demo of the list itslef
-	// you NEED an epoch or hazard pointer (or other sufficient)
-	// method of managing memory and deleting the marked nodes
-	// it is IMPORTANT to make a deep copy of the value if you 
-	// expect to keep it for a long time otherwise it will get 
-	// deleted after you set a 'safe time' at least in this method.
-
-	inline void registerThread(uint32_t) {}
-	inline void unregisterThread(uint32_t) {}
-	inline void enterEpoch(uint32_t) {}
-	inline void leaveEpoch(uint32_t) {}
-	inline uint64_t currentEpoch() const { return 0; }
+	// Slot of the calling thread, claiming one on first use.
+	static uint32_t threadId() {
+		uint32_t id = T_Threads::thread_id;
+		if (id == UNREGISTERED_THREAD)
+			id = instance().registerThread(0);
+		return id;
+	}
+
+	// Claims slot 'preferred' if it is free, otherwise the first free slot.
+	// Returns the slot the calling thread now owns.
+	uint32_t registerThread(uint32_t preferred);
+	// Frees what it can, hands the rest to the orphan list and releases the slot.
+	void unregisterThread(uint32_t);
+
+	inline void enterEpoch(uint32_t tid) {
+		if (T_Threads::epoch_nesting++ != 0)
+			return;
+		// one uncontended exchange on our own cache line: the announcement
+		// must be visible before any link of the structure is read
+		slots_[tid].epoch.exchange(globalEpoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+	}
+	inline void leaveEpoch(uint32_t tid) {
+		if (--T_Threads::epoch_nesting != 0)
+			return;
+		slots_[tid].epoch.store(EPOCH_QUIESCENT, std::memory_order_release);
+	}
+	inline uint64_t currentEpoch() const { return globalEpoch_.load(std::memory_order_acquire); }
+	// Epoch the calling thread is pinned in, EPOCH_QUIESCENT outside a
+	// critical section. A pointer read while pinned in epoch e stays valid in
+	// any later section for which this returns e again. Also
+	// EPOCH_QUIESCENT if the global epoch moved on twice between reading it
+	// and announcing it: that pin is still safe for what it reads, but
+	// pointers kept from earlier sections may be gone.
+	inline uint64_t pinnedEpoch(uint32_t tid) const {
+		uint64_t e = slots_[tid].epoch.load(std::memory_order_relaxed);
+		if (e == EPOCH_QUIESCENT || globalEpoch_.load(std::memory_order_seq_cst) > e + 1)
+			return EPOCH_QUIESCENT;
+		return e;
+	}
+
+	template<typename T>
+	void retirePtr(T* p, uint64_t epoch) {
+		retire(RETIRE_OTHER, Retired{ p, &deleteRetired<T>, epoch });
+	}
 	template<typename T>
-	void retirePtr(T* p, size_t epoch) {
+	void retireSNodeBase(T* node, uint64_t epoch) {
+		retire(RETIRE_SNODE, Retired{ node, &deleteRetired<T>, epoch });
 	}
+	template<typename T>
+	void retireLNodeBase(T* node, uint64_t epoch) {
+		retire(RETIRE_LNODE, Retired{ node, &deleteRetired<T>, epoch });
+	}
+
+	// Retire with a custom reclaim function instead of plain delete.
+	void retire(RetireList list, const Retired& r);
+
+	// Tries to advance the epoch and frees everything of the calling thread
+	// (and orphaned work) that became safe. Returns the number of pointers freed.
+	size_t collect();
 
+	~EpochManager();
 
-	inline void retireSNodeBase(void*, uint64_t) {}
-	inline void retireSNMarkable(void*, uint64_t) {}
-	inline void retireLNodeBase(void*, uint64_t) {}
-	inline void retireLMarkable(void*, uint64_t) {}
+private:
+	struct alignas(CACHE_LINE) Slot {
+		std::atomic<uint64_t> epoch{ EPOCH_QUIESCENT };
+		std::atomic<bool> inUse{ false };
+	};
 
+	EpochManager() = default;
+	EpochManager(const EpochManager&) = delete;
+	EpochManager& operator=(const EpochManager&) = delete;
+
+	bool tryAdvance();
+	static size_t reclaimSafe(std::vector<Retired>& list, uint64_t global);
+
+	alignas(CACHE_LINE) std::atomic<uint64_t> globalEpoch_{ 0 };
+	alignas(CACHE_LINE) std::atomic<uint32_t> slotHighWater_{ 0 };
+	Slot slots_[EPOCH_MAX_THREADS];
+
+	// retire lists of threads that exited before their epoch was safe
+	std::mutex orphanMutex_;
+	std::vector<Retired> orphans_;
+};
+
+// Scoped critical section: enters on construction and leaves on
+// destruction, so every return path leaves the epoch.
+class EpochGuard {
+public:
+	EpochGuard() : tid_(EpochManager::threadId()) { EpochManager::instance().enterEpoch(tid_); }
+	~EpochGuard() { EpochManager::instance().leaveEpoch(tid_); }
+	EpochGuard(const EpochGuard&) = delete;
+	EpochGuard& operator=(const EpochGuard&) = delete;
+
+	// Same interface as HazardGuard; being pinned already protects every
+	// load, so these are plain reads and no-ops.
+	template<typename Link>
+	auto protect(uint32_t, const Link& link, bool& mark) const -> decltype(link.get(mark)) {
+		return link.get(mark);
+	}
+	void assign(uint32_t, const void*) const {}
+private:
+	uint32_t tid_;
 };
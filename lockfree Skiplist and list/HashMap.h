@@ -0,0 +1,195 @@
+// Lock-free hash map: Shalev and Shavit's split-ordered list on List.
+// All items live in one List sorted by the bit-reversed hash, so every
+// bucket is a contiguous run that starts at a sentinel node; doubling the
+// table only adds sentinels, nothing is ever rehashed or moved.
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "List.h"
+#include "Counters.h"
+
+constexpr int HASH_SEGMENTS = 48;          // table grows to at most 2^47 buckets
+constexpr uint64_t HASH_INITIAL_BUCKETS = 16;
+constexpr size_t HASH_LOAD_FACTOR = 2;     // items per bucket before doubling
+constexpr uint32_t HASH_GROW_CHECK = 64;   // adds per thread between load checks
+
+// Index of the highest set bit; x must not be 0.
+inline int highestBit(uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return int(index);
+#else
+	return 63 - __builtin_clzll(x);
+#endif
+}
+
+inline uint64_t reverseBits(uint64_t x) {
+	x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+	x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+	x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+	x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+	return (x >> 32) | (x << 32);
+}
+
+// Map from uint64_t to T with expected O(1) add, remove, contains and get.
+// The list key of a node is its split-order key: the reversed bucket index
+// (even) for a bucket sentinel, the reversed hash with bit 0 set (odd) for
+// an item, so a bucket's items follow its sentinel and splitting bucket b
+// in two just inserts the sentinel of b + size halfway through its run.
+// Sentinels are created on first use, from their parent bucket (b with the
+// top bit cleared), and never removed; bucket 0 is the list head. The
+// bucket table is a directory of segments that double in size, so growing
+// it never copies. Reclaimer, Alloc and Stats are the List policies.
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator, typename Stats = NoStats>
+class LockFreeHashMap {
+	// the key is kept next to the value so items whose split-order keys
+	// collide (hashes that differ only in the top bit) are told apart
+	struct Entry {
+		uint64_t key = 0;
+		T value = T();
+	};
+	using Bucket = std::atomic<LNodeBase*>;
+	using Items = List<Entry, Reclaimer, Alloc, Stats>; // sentinels and items, one list
+	using Node = typename Items::Node;
+
+	// Items sort by split-order key, then by key. Sentinels have even
+	// split-order keys, so an odd one equal to ours is an item, or the tail.
+	struct ItemProbe {
+		uint64_t orderKey;
+		uint64_t key;
+		const LNodeBase* tail;
+		bool before(const LNodeBase* node) const {
+			return node->key < orderKey || (node->key == orderKey && node != tail && keyOf(node) < key);
+		}
+		bool matches(const LNodeBase* node) const {
+			return node->key == orderKey && node != tail && keyOf(node) == key;
+		}
+	};
+
+	Items list;
+	std::atomic<Bucket*> segments[HASH_SEGMENTS] = {};
+	std::atomic<uint64_t> bucketCount{ HASH_INITIAL_BUCKETS };
+	StripedCounter count;
+
+public:
+	LockFreeHashMap() {
+		bucket(0).store(list.head, std::memory_order_release);
+	}
+	// Not thread-safe: no other thread may be using the map. The sentinels
+	// are list nodes and go with the list.
+	~LockFreeHashMap() {
+		for (auto& segment : segments)
+			delete[] segment.load(std::memory_order_relaxed);
+	}
+	LockFreeHashMap(const LockFreeHashMap&) = delete;
+	LockFreeHashMap& operator=(const LockFreeHashMap&) = delete;
+
+	bool add(uint64_t key, T value) {
+		uint64_t h = hash(key);
+		bool inserted = false;
+		list.insertFrom(sentinelFor(h), probe(h, key), itemOrderKey(h), Entry{ key, std::move(value) }, inserted);
+		if (inserted) {
+			count.add(Reclaimer::threadId(), 1);
+			maybeGrow();
+		}
+		return inserted;
+	}
+	bool remove(uint64_t key) {
+		uint64_t h = hash(key);
+		if (!list.removeFrom(sentinelFor(h), probe(h, key)))
+			return false;
+		count.add(Reclaimer::threadId(), -1);
+		return true;
+	}
+	bool contains(uint64_t key) {
+		uint64_t h = hash(key);
+		return list.containsFrom(sentinelFor(h), probe(h, key));
+	}
+	// Returns a copy of the value, taken while the node is still protected.
+	std::optional<T> get(uint64_t key) {
+		uint64_t h = hash(key);
+		std::optional<Entry> entry = list.getFrom(sentinelFor(h), probe(h, key));
+		if (!entry)
+			return std::nullopt;
+		return std::move(entry->value);
+	}
+
+	// Approximate while others update the map, see StripedCounter.
+	size_t size() const { return count.read(); }
+	uint64_t buckets() const { return bucketCount.load(std::memory_order_relaxed); }
+
+private:
+	// splitmix64's finalizer: a bijection, so distinct keys only share a
+	// split-order key when their hashes differ in the top bit
+	static uint64_t hash(uint64_t key) {
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+		return key;
+	}
+	static uint64_t itemOrderKey(uint64_t h) { return reverseBits(h) | 1; }
+	static uint64_t sentinelOrderKey(uint64_t b) { return reverseBits(b); } // b < 2^63: even
+	static uint64_t keyOf(const LNodeBase* node) { return static_cast<const Node*>(node)->data.key; }
+	ItemProbe probe(uint64_t h, uint64_t key) const { return ItemProbe{ itemOrderKey(h), key, list.tail }; }
+
+	// Segment 0 holds bucket 0, segment s >= 1 buckets [2^(s-1), 2^s).
+	static int segmentOf(uint64_t b) { return b == 0 ? 0 : highestBit(b) + 1; }
+	static size_t segmentSize(int s) { return s == 0 ? 1 : size_t(1) << (s - 1); }
+
+	Bucket& bucket(uint64_t b) {
+		int s = segmentOf(b);
+		Bucket* segment = segments[s].load(std::memory_order_acquire);
+		if (!segment) {
+			Bucket* fresh = new Bucket[segmentSize(s)](); // all nullptr
+			if (segments[s].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel))
+				segment = fresh;
+			else
+				delete[] fresh; // segment now holds the winner's
+		}
+		return segment[s == 0 ? 0 : b - (uint64_t(1) << (s - 1))];
+	}
+
+	// The sentinel of h's bucket under the current table size.
+	LNodeBase* sentinelFor(uint64_t h) {
+		uint64_t b = h & (bucketCount.load(std::memory_order_acquire) - 1);
+		LNodeBase* sentinel = bucket(b).load(std::memory_order_acquire);
+		return sentinel ? sentinel : initBucket(b);
+	}
+
+	// Inserts bucket b's sentinel starting from its parent's, which splits
+	// the parent's run. Racing threads find the same node: the list holds
+	// one node per split-order key.
+	LNodeBase* initBucket(uint64_t b) {
+		uint64_t parent = b & ~(uint64_t(1) << highestBit(b));
+		LNodeBase* start = bucket(parent).load(std::memory_order_acquire);
+		if (!start)
+			start = initBucket(parent);
+		uint64_t orderKey = sentinelOrderKey(b);
+		bool inserted = false;
+		LNodeBase* sentinel = list.insertFrom(start, LKeyProbe{ orderKey }, orderKey, Entry{}, inserted);
+		bucket(b).store(sentinel, std::memory_order_release);
+		return sentinel;
+	}
+
+	// Every HASH_GROW_CHECK adds a thread compares the item count with the
+	// table size and doubles it when the load factor is exceeded. The new
+	// buckets fill in lazily.
+	void maybeGrow() {
+		static thread_local uint32_t addsSinceCheck = 0;
+		if (++addsSinceCheck < HASH_GROW_CHECK)
+			return;
+		addsSinceCheck = 0;
+		uint64_t n = bucketCount.load(std::memory_order_relaxed);
+		if (size() > n * HASH_LOAD_FACTOR && n < (uint64_t(1) << (HASH_SEGMENTS - 1)))
+			bucketCount.compare_exchange_strong(n, n * 2, std::memory_order_release, std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,134 @@
+#include "HazardPointers.h"
+#include <algorithm>
+#include <stdexcept>
+namespace T_Threads {
+	thread_local uint32_t hp_thread_id = UNREGISTERED_THREAD;
+	thread_local uint32_t hp_nesting = 0;
+	thread_local uint32_t hp_used = 0;
+}
+
+namespace {
+	// Per-thread retire lists. The destructor runs at thread exit and
+	// releases the record of threads that never called unregisterThread().
+	struct RetireState {
+		std::vector<HazardPointerManager::Retired> lists[RETIRE_LIST_COUNT];
+		size_t pending = 0;
+		~RetireState() {
+			if (T_Threads::hp_thread_id != UNREGISTERED_THREAD)
+				HazardPointerManager::instance().unregisterThread(T_Threads::hp_thread_id);
+		}
+	};
+	thread_local RetireState retireState;
+}
+
+uint32_t HazardPointerManager::registerThread(uint32_t preferred) {
+	if (T_Threads::hp_thread_id != UNREGISTERED_THREAD)
+		return T_Threads::hp_thread_id;
+
+	uint32_t id = UNREGISTERED_THREAD;
+	bool expected = false;
+	if (preferred < HP_MAX_THREADS && records_[preferred].inUse.compare_exchange_strong(expected, true))
+		id = preferred;
+	for (uint32_t i = 0; id == UNREGISTERED_THREAD && i < HP_MAX_THREADS; ++i) {
+		expected = false;
+		if (records_[i].inUse.compare_exchange_strong(expected, true))
+			id = i;
+	}
+	if (id == UNREGISTERED_THREAD)
+		throw std::runtime_error("HazardPointerManager: no free thread record");
+
+	uint32_t high = recordHighWater_.load(std::memory_order_relaxed);
+	while (high <= id && !recordHighWater_.compare_exchange_weak(high, id + 1)) {}
+
+	retireState.pending = 0; // touch the thread_local so its destructor runs at exit
+	T_Threads::hp_thread_id = id;
+	return id;
+}
+
+void HazardPointerManager::unregisterThread(uint32_t) {
+	uint32_t id = T_Threads::hp_thread_id;
+	if (id == UNREGISTERED_THREAD)
+		return;
+
+	T_Threads::hp_used = HAZARDS_PER_THREAD;
+	clear(id);
+	T_Threads::hp_nesting = 0;
+	scan();
+	{
+		std::lock_guard<std::mutex> lock(orphanMutex_);
+		for (auto& list : retireState.lists) {
+			orphans_.insert(orphans_.end(), list.begin(), list.end());
+			list.clear();
+		}
+	}
+	retireState.pending = 0;
+	records_[id].inUse.store(false, std::memory_order_release);
+	T_Threads::hp_thread_id = UNREGISTERED_THREAD;
+}
+
+size_t HazardPointerManager::scanThreshold() const {
+	// proportional to the number of hazards so every scan frees at least
+	// half of what it looks at
+	size_t hazards = size_t(recordHighWater_.load(std::memory_order_relaxed)) * HAZARDS_PER_THREAD;
+	return std::max(RECLAIM_BATCH, 2 * hazards);
+}
+
+void HazardPointerManager::retire(RetireList list, const Retired& r) {
+	threadId();
+	retireState.lists[list].push_back(r);
+	if (++retireState.pending >= scanThreshold())
+		scan();
+}
+
+size_t HazardPointerManager::reclaimUnprotected(std::vector<Retired>& list, const std::vector<const void*>& protectedPtrs) {
+	size_t kept = 0;
+	size_t freed = 0;
+	for (size_t i = 0; i < list.size(); ++i) {
+		if (!std::binary_search(protectedPtrs.begin(), protectedPtrs.end(), static_cast<const void*>(list[i].ptr))) {
+			list[i].reclaim(list[i].ptr);
+			++freed;
+		}
+		else {
+			list[kept++] = list[i];
+		}
+	}
+	list.resize(kept);
+	return freed;
+}
+
+size_t HazardPointerManager::scan() {
+	// adopt orphans before the snapshot: a hazard published before they were
+	// retired must be seen by it
+	if (orphanMutex_.try_lock()) {
+		auto& adopted = retireState.lists[RETIRE_OTHER];
+		adopted.insert(adopted.end(), orphans_.begin(), orphans_.end());
+		orphans_.clear();
+		orphanMutex_.unlock();
+	}
+
+	std::vector<const void*> protectedPtrs;
+	uint32_t count = recordHighWater_.load(std::memory_order_acquire);
+	for (uint32_t t = 0; t < count; ++t) {
+		for (uint32_t i = 0; i < HAZARDS_PER_THREAD; ++i) {
+			const void* p = records_[t].hazards[i].load(std::memory_order_seq_cst);
+			if (p)
+				protectedPtrs.push_back(p);
+		}
+	}
+	std::sort(protectedPtrs.begin(), protectedPtrs.end());
+
+	size_t freed = 0;
+	size_t pending = 0;
+	for (auto& list : retireState.lists) {
+		freed += reclaimUnprotected(list, protectedPtrs);
+		pending += list.size();
+	}
+	retireState.pending = pending;
+	return freed;
+}
+
+HazardPointerManager::~HazardPointerManager() {
+	for (auto& r : orphans_)
+		r.reclaim(r.ptr);
+	orphans_.clear();
+}
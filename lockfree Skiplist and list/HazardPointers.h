@@ -0,0 +1,156 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include "Epochs.h"
+
+constexpr uint32_t HP_MAX_THREADS = EPOCH_MAX_THREADS;
+// SkipList needs two per level (preds/succs) plus a few for traversal and
+// its iterator, List needs five.
+constexpr uint32_t HAZARDS_PER_THREAD = 44;
+
+namespace T_Threads {
+	extern thread_local uint32_t hp_thread_id;
+	extern thread_local uint32_t hp_nesting;
+	extern thread_local uint32_t hp_used; // slots written since the outermost guard
+}
+
+class HazardGuard;
+
+// Hazard-pointer reclamation, a drop-in policy for EpochManager.
+// Readers publish every node they are about to dereference in one of their
+// thread's hazard slots and re-check the link it came from. A retired
+// pointer is freed once no slot holds it, so a stalled thread can only pin
+// the handful of nodes it has published and memory use stays bounded
+// (roughly threads * HAZARDS_PER_THREAD plus one scan batch per thread).
+//
+// The price is that readers may not walk through marked nodes: the
+// successor of a marked node can already be gone, so traversals snip or
+// restart instead (TRAVERSE_MARKED == false).
+class HazardPointerManager {
+public:
+	using Retired = RetiredPtr;
+	using Guard = HazardGuard;
+	static constexpr bool TRAVERSE_MARKED = false;
+	// scan once a thread holds this many retired pointers (at least;
+	// see scanThreshold())
+	static constexpr size_t RECLAIM_BATCH = 64;
+
+	static HazardPointerManager& instance() {
+		static HazardPointerManager inst;
+		return inst;
+	}
+
+	static uint32_t threadId() {
+		uint32_t id = T_Threads::hp_thread_id;
+		if (id == UNREGISTERED_THREAD)
+			id = instance().registerThread(0);
+		return id;
+	}
+
+	uint32_t registerThread(uint32_t preferred);
+	void unregisterThread(uint32_t);
+
+	// EpochManager API: sections are tracked by HazardGuard, epochs do not exist.
+	inline void enterEpoch(uint32_t) { ++T_Threads::hp_nesting; }
+	inline void leaveEpoch(uint32_t tid) {
+		if (--T_Threads::hp_nesting == 0)
+			clear(tid);
+	}
+	inline uint64_t currentEpoch() const { return 0; }
+	// Nothing read in one section is safe in the next.
+	static constexpr uint64_t EPOCH_QUIESCENT = UINT64_MAX;
+	inline uint64_t pinnedEpoch(uint32_t) const { return EPOCH_QUIESCENT; }
+
+	template<typename T>
+	void retirePtr(T* p, uint64_t) {
+		retire(RETIRE_OTHER, Retired{ p, &deleteRetired<T>, 0 });
+	}
+	template<typename T>
+	void retireSNodeBase(T* node, uint64_t) {
+		retire(RETIRE_SNODE, Retired{ node, &deleteRetired<T>, 0 });
+	}
+	template<typename T>
+	void retireLNodeBase(T* node, uint64_t) {
+		retire(RETIRE_LNODE, Retired{ node, &deleteRetired<T>, 0 });
+	}
+	void retire(RetireList list, const Retired& r);
+
+	// Frees every pointer of the calling thread (and orphaned work) that no
+	// hazard slot protects. Returns the number of pointers freed.
+	size_t scan();
+
+	inline std::atomic<const void*>& hazard(uint32_t tid, uint32_t slot) {
+		return records_[tid].hazards[slot];
+	}
+	inline void clear(uint32_t tid) {
+		for (uint32_t i = 0; i < T_Threads::hp_used; ++i)
+			records_[tid].hazards[i].store(nullptr, std::memory_order_release);
+		T_Threads::hp_used = 0;
+	}
+
+	~HazardPointerManager();
+
+private:
+	struct alignas(CACHE_LINE) Record {
+		std::atomic<const void*> hazards[HAZARDS_PER_THREAD] = {};
+		std::atomic<bool> inUse{ false };
+	};
+
+	HazardPointerManager() = default;
+	HazardPointerManager(const HazardPointerManager&) = delete;
+	HazardPointerManager& operator=(const HazardPointerManager&) = delete;
+
+	size_t scanThreshold() const;
+	static size_t reclaimUnprotected(std::vector<Retired>& list, const std::vector<const void*>& protectedPtrs);
+
+	alignas(CACHE_LINE) std::atomic<uint32_t> recordHighWater_{ 0 };
+	Record records_[HP_MAX_THREADS];
+
+	std::mutex orphanMutex_;
+	std::vector<Retired> orphans_;
+};
+
+// Scoped read section for HazardPointerManager. Sections nest; the
+// outermost one clears the thread's hazards when it ends.
+class HazardGuard {
+public:
+	HazardGuard() : tid_(HazardPointerManager::threadId()) { ++T_Threads::hp_nesting; }
+	~HazardGuard() { HazardPointerManager::instance().leaveEpoch(tid_); }
+	HazardGuard(const HazardGuard&) = delete;
+	HazardGuard& operator=(const HazardGuard&) = delete;
+
+	// Loads link, publishes the target in 'slot' and re-reads the link until
+	// both agree. The node owning link must itself be protected; the result
+	// is then safe to dereference until the slot is overwritten.
+	template<typename Link>
+	auto protect(uint32_t slot, const Link& link, bool& mark) -> decltype(link.get(mark)) {
+		auto& h = HazardPointerManager::instance().hazard(tid_, slot);
+		touch(slot);
+		auto p = link.get(mark);
+		while (true) {
+			h.exchange(p, std::memory_order_seq_cst);
+			bool again = false;
+			// seq_cst whatever LINK_LOAD_ORDER is: the re-read must not pass
+			// the publish, or a reclaimer's scan could miss it
+			auto q = link.get(again, std::memory_order_seq_cst);
+			if (q == p && again == mark)
+				return p;
+			p = q;
+			mark = again;
+		}
+	}
+	// Publishes a pointer that is already protected by another slot.
+	void assign(uint32_t slot, const void* p) {
+		touch(slot);
+		HazardPointerManager::instance().hazard(tid_, slot).store(p, std::memory_order_release);
+	}
+private:
+	static void touch(uint32_t slot) {
+		if (slot >= T_Threads::hp_used)
+			T_Threads::hp_used = slot + 1;
+	}
+	uint32_t tid_;
+};
@@ -0,0 +1,518 @@
+// Randomized linearizability check for SkipList, List, EliminationSkipList,
+// MultiSkipList and MultiQueue. Each round a few threads run a few random
+// operations on a handful of keys of a fresh structure, and every call's
+// start and return are stamped on one shared logical clock. The round
+// passes if some order of the calls that respects those stamps gives the
+// same results on a sequential model (Wing and Gong's search, with Lowe's
+// cache of visited states). The model is the structure's contract: a map,
+// a map whose popMin may take any item (relaxed popMin), a multimap that is
+// FIFO among adds that did not overlap, or a pool (MultiQueue). Where
+// there is a Finger, half the adds, removes and contains go through the
+// thread's, which lives for the round and answers to the same model. main.cpp
+// runs it with --lincheck; sanitize.sh runs it under TSan and ASan so the
+// sanitizers watch the same interleavings (see README).
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+constexpr int LINCHECK_MAX_CALLS = 64; // per round, the visited set keys on a 64-bit mask
+constexpr size_t LINCHECK_BATCH = 2;   // popMinBatch's n
+
+enum class LinOp { Add, Remove, Contains, Get, PopMin, PopMinBatch, UpdateKey };
+
+inline const char* linOpName(LinOp op) {
+	switch (op) {
+	case LinOp::Add: return "add";
+	case LinOp::Remove: return "remove";
+	case LinOp::Contains: return "contains";
+	case LinOp::Get: return "get";
+	case LinOp::PopMin: return "popMin";
+	case LinOp::PopMinBatch: return "popMinBatch";
+	default: return "updateKey";
+	}
+}
+
+// One call and what it returned: 0/1 for bool results, the value or -1
+// for optional ones, the count for popMinBatch, whose values are in batch.
+// The checker splits a batch into one step per value, each after the one
+// before, plus an empty pop if it came back short: every item is popped
+// at its own point inside the call.
+struct LinCall {
+	LinOp op;
+	int thread;
+	uint64_t key;
+	uint64_t key2; // updateKey's new key
+	int value;     // add's value
+	bool finger = false; // add/remove/contains through the thread's Finger
+	int result = 0;
+	std::vector<int> batch;
+	uint64_t invoked = 0;
+	uint64_t returned = 0;
+	int after = -1; // checker steps: the step this one must follow
+};
+
+template <typename Q, typename = void>
+struct LinHasPopMin : std::false_type {};
+template <typename Q>
+struct LinHasPopMin<Q, std::void_t<decltype(std::declval<Q&>().popMin())>> : std::true_type {};
+template <typename Q, typename = void>
+struct LinHasPopMinBatch : std::false_type {};
+template <typename Q>
+struct LinHasPopMinBatch<Q, std::void_t<decltype(std::declval<Q&>().popMinBatch(std::declval<std::vector<int>&>(), size_t()))>> : std::true_type {};
+template <typename Q, typename = void>
+struct LinHasFinger : std::false_type {};
+template <typename Q>
+struct LinHasFinger<Q, std::void_t<typename Q::Finger>> : std::true_type {};
+template <typename Q, typename = void>
+struct LinHasUpdateKey : std::false_type {};
+template <typename Q>
+struct LinHasUpdateKey<Q, std::void_t<decltype(std::declval<Q&>().updateKey(uint64_t(), uint64_t()))>> : std::true_type {};
+
+inline int linResult(bool b) { return b ? 1 : 0; }
+inline int linResult(const std::optional<int>& v) { return v ? *v : -1; }
+
+// A thread's Finger for one round, or nothing if Queue has none.
+template <typename Queue, bool = LinHasFinger<Queue>::value>
+struct LinFinger {};
+template <typename Queue>
+struct LinFinger<Queue, true> {
+	typename Queue::Finger finger;
+};
+
+template <typename Queue>
+int linCall(Queue& q, LinCall& c, LinFinger<Queue>& f) {
+	if constexpr (LinHasFinger<Queue>::value) {
+		if (c.finger) {
+			switch (c.op) {
+			case LinOp::Add: return linResult(q.add(c.key, c.value, f.finger));
+			case LinOp::Remove: return linResult(q.remove(c.key, f.finger));
+			case LinOp::Contains: return linResult(q.contains(c.key, f.finger));
+			default: break;
+			}
+		}
+	}
+	switch (c.op) {
+	case LinOp::Add: return linResult(q.add(c.key, c.value));
+	case LinOp::Remove: return linResult(q.remove(c.key));
+	case LinOp::Contains: return linResult(q.contains(c.key));
+	case LinOp::Get: return linResult(q.get(c.key));
+	case LinOp::PopMin:
+		if constexpr (LinHasPopMin<Queue>::value)
+			return linResult(q.popMin());
+		return -1;
+	case LinOp::PopMinBatch:
+		if constexpr (LinHasPopMinBatch<Queue>::value)
+			return int(q.popMinBatch(c.batch, LINCHECK_BATCH));
+		return 0;
+	default:
+		if constexpr (LinHasUpdateKey<Queue>::value)
+			return linResult(q.updateKey(c.key, c.key2));
+		return 0;
+	}
+}
+
+// Sequential models. apply(steps, i, each) calls each(next) for every
+// state step i can lead to with the result it had; more than one when the
+// call does not say which item it took.
+
+// A map from key to value. With AnyPop, popMin may take any item (the
+// SprayList-style relaxed popMin) but still only reports empty on an
+// empty map; popMinBatch is strict either way.
+template <bool AnyPop>
+struct LinMapSpec {
+	std::map<uint64_t, int> items;
+
+	static bool supports(LinOp) { return true; }
+	void prefill(uint64_t key, int value) { items.emplace(key, value); }
+	bool operator<(const LinMapSpec& other) const { return items < other.items; }
+
+	template <typename F>
+	void apply(const std::vector<LinCall>& steps, size_t i, F&& each) const {
+		const LinCall& c = steps[i];
+		LinMapSpec next = *this;
+		switch (c.op) {
+		case LinOp::Add:
+			if (linResult(next.items.emplace(c.key, c.value).second) == c.result)
+				each(next);
+			return;
+		case LinOp::Remove:
+			if (linResult(next.items.erase(c.key) != 0) == c.result)
+				each(next);
+			return;
+		case LinOp::Contains:
+			if (linResult(items.count(c.key) != 0) == c.result)
+				each(next);
+			return;
+		case LinOp::Get: {
+			auto it = items.find(c.key);
+			if ((it == items.end() ? -1 : it->second) == c.result)
+				each(next);
+			return;
+		}
+		case LinOp::PopMin:
+		case LinOp::PopMinBatch:
+			if (items.empty()) {
+				if (c.result == -1)
+					each(next);
+				return;
+			}
+			for (auto it = items.begin(); it != items.end(); ++it) {
+				if (it->second == c.result) {
+					next.items.erase(it->first);
+					each(next);
+					return;
+				}
+				if (!AnyPop || c.op == LinOp::PopMinBatch)
+					return; // only the smallest would do
+			}
+			return;
+		default: {
+			auto it = items.find(c.key);
+			bool moved = it != items.end() && !items.count(c.key2); // as SkipListMap: updateKey(k, k) finds k taken
+			if (linResult(moved) != c.result)
+				return;
+			if (moved) {
+				next.items.erase(c.key);
+				next.items.emplace(c.key2, it->second);
+			}
+			each(next);
+			return;
+		}
+		}
+	}
+};
+using LinMapModel = LinMapSpec<false>;
+using LinAnyPopModel = LinMapSpec<true>;
+
+// SkipListMultiMap: every key holds a queue of items. Equal keys drawn by
+// overlapping calls may come out in either order (their seqs need not
+// follow visibility), so an item counts as the oldest of its key unless
+// another one's add or move returned before its own began.
+struct LinMultiModel {
+	// per key: (step that placed it, -1 for the prefill; value)
+	std::map<uint64_t, std::set<std::pair<int, int>>> items;
+
+	static bool supports(LinOp) { return true; }
+	void prefill(uint64_t key, int value) { items[key].emplace(-1, value); }
+	bool operator<(const LinMultiModel& other) const { return items < other.items; }
+
+	static bool older(const std::vector<LinCall>& steps, int a, int b) {
+		if (b < 0)
+			return false;
+		return a < 0 || steps[size_t(a)].returned < steps[size_t(b)].invoked;
+	}
+	// Calls f(item) for each item of key that may be its oldest.
+	template <typename F>
+	void eachOldest(const std::vector<LinCall>& steps, uint64_t key, F&& f) const {
+		auto it = items.find(key);
+		if (it == items.end())
+			return;
+		for (auto& item : it->second) {
+			bool oldest = true;
+			for (auto& other : it->second)
+				if (older(steps, other.first, item.first))
+					oldest = false;
+			if (oldest)
+				f(item);
+		}
+	}
+	LinMultiModel without(uint64_t key, const std::pair<int, int>& item) const {
+		LinMultiModel next = *this;
+		auto it = next.items.find(key);
+		it->second.erase(item);
+		if (it->second.empty())
+			next.items.erase(it);
+		return next;
+	}
+
+	template <typename F>
+	void apply(const std::vector<LinCall>& steps, size_t i, F&& each) const {
+		const LinCall& c = steps[i];
+		bool present = items.count(c.key) != 0;
+		switch (c.op) {
+		case LinOp::Add:
+			if (c.result == 1) {
+				LinMultiModel next = *this;
+				next.items[c.key].emplace(int(i), c.value);
+				each(next);
+			}
+			return;
+		case LinOp::Remove:
+			if (!present && c.result == 0)
+				each(*this);
+			if (present && c.result == 1)
+				eachOldest(steps, c.key, [&](const std::pair<int, int>& item) { each(without(c.key, item)); });
+			return;
+		case LinOp::Contains:
+			if (linResult(present) == c.result)
+				each(*this);
+			return;
+		case LinOp::Get:
+			if (!present && c.result == -1)
+				each(*this);
+			eachOldest(steps, c.key, [&](const std::pair<int, int>& item) {
+				if (item.second == c.result)
+					each(*this);
+			});
+			return;
+		case LinOp::PopMin:
+		case LinOp::PopMinBatch:
+			if (items.empty()) {
+				if (c.result == -1)
+					each(*this);
+				return;
+			}
+			eachOldest(steps, items.begin()->first, [&](const std::pair<int, int>& item) {
+				if (item.second == c.result)
+					each(without(items.begin()->first, item));
+			});
+			return;
+		default:
+			if (!present && c.result == 0)
+				each(*this);
+			if (present && c.result == 1) {
+				eachOldest(steps, c.key, [&](const std::pair<int, int>& item) {
+					LinMultiModel next = without(c.key, item);
+					next.items[c.key2].emplace(int(i), item.second);
+					each(next);
+				});
+			}
+			return;
+		}
+	}
+};
+
+// MultiQueue as its priority-queue interface only: add may keep a key
+// that another shard holds too (false only if the key is there), and pops
+// take any item. A pop may also come back empty while a racing add or pop
+// moves the only items between the shards it looks at, so empty is always
+// a valid answer; what is checked is that no item is invented, lost twice
+// or returned twice
+struct LinPoolModel {
+	std::set<std::pair<uint64_t, int>> items;
+
+	static bool supports(LinOp op) { return op == LinOp::Add || op == LinOp::PopMin || op == LinOp::PopMinBatch; }
+	void prefill(uint64_t key, int value) { items.emplace(key, value); }
+	bool operator<(const LinPoolModel& other) const { return items < other.items; }
+
+	template <typename F>
+	void apply(const std::vector<LinCall>& steps, size_t i, F&& each) const {
+		const LinCall& c = steps[i];
+		if (c.op == LinOp::Add) {
+			auto it = items.lower_bound({ c.key, INT32_MIN });
+			bool held = it != items.end() && it->first == c.key;
+			if (c.result == 1) {
+				LinPoolModel next = *this;
+				next.items.emplace(c.key, c.value);
+				each(next);
+			}
+			else if (held) {
+				each(*this);
+			}
+			return;
+		}
+		if (c.result == -1)
+			each(*this);
+		for (auto& item : items) {
+			if (item.second == c.result) {
+				LinPoolModel next = *this;
+				next.items.erase(item);
+				each(next);
+				return;
+			}
+		}
+	}
+};
+
+// True if the steps have a linearization starting from initial. A step can
+// go next if no other pending step returned before it was invoked, and
+// after the step it follows.
+template <typename Model>
+class LinChecker {
+public:
+	explicit LinChecker(const std::vector<LinCall>& steps) : steps(steps) {}
+
+	bool check(const Model& initial) {
+		visited.clear();
+		return search(initial, 0);
+	}
+
+private:
+	const std::vector<LinCall>& steps;
+	std::set<std::pair<uint64_t, Model>> visited; // dead ends
+
+	bool search(const Model& model, uint64_t done) {
+		if (done == (steps.size() == 64 ? ~0ull : (1ull << steps.size()) - 1))
+			return true;
+		if (!visited.emplace(done, model).second)
+			return false;
+		uint64_t firstReturn = UINT64_MAX;
+		for (size_t i = 0; i < steps.size(); ++i)
+			if (!(done >> i & 1) && steps[i].returned < firstReturn)
+				firstReturn = steps[i].returned;
+		for (size_t i = 0; i < steps.size(); ++i) {
+			const LinCall& s = steps[i];
+			if ((done >> i & 1) || s.invoked > firstReturn || (s.after >= 0 && !(done >> s.after & 1)))
+				continue;
+			bool found = false;
+			model.apply(steps, i, [&](const Model& next) {
+				if (!found && search(next, done | 1ull << i))
+					found = true;
+			});
+			if (found)
+				return true;
+		}
+		return false;
+	}
+};
+
+// The checker's steps for a round: calls as they are, popMinBatch split
+// as LinCall describes.
+inline std::vector<LinCall> linSteps(const std::vector<LinCall>& calls) {
+	std::vector<LinCall> steps;
+	for (const LinCall& c : calls) {
+		if (c.op != LinOp::PopMinBatch) {
+			steps.push_back(c);
+			continue;
+		}
+		int after = -1;
+		std::vector<int> results = c.batch;
+		if (results.size() < LINCHECK_BATCH)
+			results.push_back(-1);
+		for (int value : results) {
+			LinCall step = c;
+			step.batch.clear();
+			step.result = value;
+			step.after = after;
+			after = int(steps.size());
+			steps.push_back(step);
+		}
+	}
+	return steps;
+}
+
+template <typename Queue>
+struct LinMake {
+	std::unique_ptr<Queue> operator()() const { return std::make_unique<Queue>(); }
+};
+
+// Runs rounds of threadCount threads with opsPerThread random calls each
+// on keys [0, keys), after a random prefill, and prints the first history
+// that does not linearize against Model. make builds each round's
+// structure. Only the operations both Queue and Model have are drawn.
+// Returns the number of rounds that failed.
+template <typename Queue, typename Model = LinMapModel, typename Make = LinMake<Queue>>
+int lincheck(const char* name, int rounds, Make make = Make(), int threadCount = 3, int opsPerThread = 5, int keys = 6) {
+	std::vector<LinOp> ops;
+	for (LinOp op : { LinOp::Add, LinOp::Add, LinOp::Remove, LinOp::Contains, LinOp::Get })
+		if (Model::supports(op))
+			ops.push_back(op);
+	if (LinHasPopMin<Queue>::value && Model::supports(LinOp::PopMin))
+		ops.insert(ops.end(), { LinOp::PopMin, LinOp::PopMin });
+	if (LinHasPopMinBatch<Queue>::value && Model::supports(LinOp::PopMinBatch))
+		ops.push_back(LinOp::PopMinBatch);
+	if (LinHasUpdateKey<Queue>::value && Model::supports(LinOp::UpdateKey))
+		ops.insert(ops.end(), { LinOp::UpdateKey, LinOp::UpdateKey });
+	int stepsPerCall = LinHasPopMinBatch<Queue>::value ? int(LINCHECK_BATCH) + 1 : 1;
+	if (threadCount * opsPerThread * stepsPerCall > LINCHECK_MAX_CALLS)
+		opsPerThread = LINCHECK_MAX_CALLS / (threadCount * stepsPerCall);
+
+	std::unique_ptr<Queue> q;
+	std::vector<LinCall> calls;
+	std::atomic<uint64_t> clock{ 0 };
+	std::atomic<int> started{ 0 };  // rounds released to the workers
+	std::atomic<int> finished{ 0 }; // worker rounds completed
+	std::atomic<bool> stop{ false };
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threadCount; ++t) {
+		workers.emplace_back([&, t]() {
+			for (int round = 1; ; ++round) {
+				while (started.load(std::memory_order_acquire) < round && !stop.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				if (stop.load(std::memory_order_acquire))
+					return;
+				LinFinger<Queue> finger; // one list, one thread
+				for (int i = 0; i < opsPerThread; ++i) {
+					LinCall& c = calls[size_t(t) * opsPerThread + i];
+					c.invoked = clock.fetch_add(1, std::memory_order_seq_cst);
+					c.result = linCall(*q, c, finger);
+					c.returned = clock.fetch_add(1, std::memory_order_seq_cst);
+				}
+				finished.fetch_add(1, std::memory_order_release);
+			}
+		});
+	}
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	auto random = [&]() {
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		return x;
+	};
+	int failed = 0;
+	for (int round = 1; round <= rounds; ++round) {
+		q = make();
+		Model initial;
+		std::map<uint64_t, int> prefilled;
+		int nextValue = 0;
+		for (int k = 0; k < keys; ++k)
+			if (random() % 2) {
+				q->add(uint64_t(k), nextValue);
+				initial.prefill(uint64_t(k), nextValue);
+				prefilled.emplace(uint64_t(k), nextValue++);
+			}
+		calls.assign(size_t(threadCount) * opsPerThread, LinCall{});
+		for (size_t i = 0; i < calls.size(); ++i) {
+			LinCall& c = calls[i];
+			c.op = ops[random() % ops.size()];
+			c.thread = int(i) / opsPerThread;
+			c.key = random() % keys;
+			c.key2 = random() % keys;
+			c.value = nextValue++;
+			c.finger = LinHasFinger<Queue>::value && (c.op == LinOp::Add || c.op == LinOp::Remove || c.op == LinOp::Contains)
+				&& random() % 2;
+		}
+		started.store(round, std::memory_order_release);
+		while (finished.load(std::memory_order_acquire) < round * threadCount)
+			std::this_thread::yield();
+
+		if (LinChecker<Model>(linSteps(calls)).check(initial))
+			continue;
+		if (failed++ == 0) {
+			std::cout << "Lincheck [" << name << "] round " << round << " does not linearize; started with";
+			for (auto& kv : prefilled)
+				std::cout << " " << kv.first << "=" << kv.second;
+			std::cout << "\n";
+			for (const LinCall& c : calls) {
+				std::cout << "  thread " << c.thread << " [" << c.invoked << ", " << c.returned << "] " << linOpName(c.op) << "(";
+				if (c.op == LinOp::PopMinBatch)
+					std::cout << LINCHECK_BATCH;
+				else if (c.op != LinOp::PopMin)
+					std::cout << c.key;
+				if (c.op == LinOp::Add)
+					std::cout << ", " << c.value;
+				if (c.op == LinOp::UpdateKey)
+					std::cout << ", " << c.key2;
+				std::cout << (c.finger ? ", finger" : "") << ") -> " << c.result;
+				for (size_t i = 0; i < c.batch.size(); ++i)
+					std::cout << (i ? ", " : " {") << c.batch[i] << (i + 1 == c.batch.size() ? "}" : "");
+				std::cout << "\n";
+			}
+		}
+	}
+	stop.store(true, std::memory_order_release);
+	for (auto& th : workers) th.join();
+	q.reset();
+	std::cout << "Lincheck [" << name << "] " << rounds << " rounds of " << threadCount << " x " << opsPerThread
+		<< " calls on " << keys << " keys, failures: " << failed << "\n";
+	return failed;
+}
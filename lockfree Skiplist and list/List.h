@@ -1,107 +1,94 @@
 #pragma once
 #define NOMINMAX
 #include <vector>
+#include <utility>
+#include <new>
+#include <optional>
 #include <atomic>
 #include <iostream>
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
 #include <limits>
 #include <cstdint>
 #include "Epochs.h"
+#include "HazardPointers.h"
+#include "NodeAllocator.h"
+#include "Counters.h"
+#include "Stats.h"
 
 struct LNodeBase; // forward declaration
 
-// MarkableReference stores a Node* and a bool mark
-struct LMarkableReference {
-	LNodeBase* val_;
-	bool marked_;
-
-	LMarkableReference(LNodeBase* val = nullptr, bool mark = false)
-		: val_(val), marked_(mark) {
-	}
-};
-
-// Hardcoded MarkablePointer for Node*
+// MarkablePointer packs a Node* and a bool mark into one word.
+// Nodes are at least 2-byte aligned, so bit 0 of the address is free to
+// carry the mark: a read is a single load and a CAS never allocates.
 struct LMarkablePointer {
-	std::atomic<LMarkableReference*> ref_;
+	static constexpr uintptr_t MARK_BIT = 1;
+	std::atomic<uintptr_t> ref_;
 
-	LMarkablePointer() {
-		ref_.store(new LMarkableReference(nullptr, false), std::memory_order_release);
+	static uintptr_t pack(LNodeBase* val, bool mark) {
+		return reinterpret_cast<uintptr_t>(val) | (mark ? MARK_BIT : 0);
 	}
-
-	LMarkablePointer(LNodeBase* val, bool mark) {
-		ref_.store(new LMarkableReference(val, mark), std::memory_order_release);
+	static LNodeBase* unpack(uintptr_t word) {
+		return reinterpret_cast<LNodeBase*>(word & ~MARK_BIT);
 	}
 
-	~LMarkablePointer() {
-		delete ref_.load(std::memory_order_acquire);
-	}
+	LMarkablePointer() : ref_(0) {}
+
+	LMarkablePointer(LNodeBase* val, bool mark) : ref_(pack(val, mark)) {}
 
 	// get() like Java: returns the pointer and sets the mark
-	LNodeBase* get(bool& mark) const {
-		LMarkableReference* temp = ref_.load(std::memory_order_acquire);
-		mark = temp->marked_;
-		return temp->val_;
+	LNodeBase* get(bool& mark, std::memory_order order = LINK_LOAD_ORDER) const {
+		uintptr_t word = ref_.load(order);
+		mark = (word & MARK_BIT) != 0;
+		return unpack(word);
 	}
+	// May fail spuriously; callers loop until the mark is seen.
 	bool attemptMark(LNodeBase* expectedPtr, bool newMark) {
-		LMarkableReference* curr = ref_.load(std::memory_order_acquire);
+		uintptr_t curr = ref_.load(std::memory_order_relaxed);
 
 		// Only attempt if the pointer part matches expectedPtr
-		if (curr->val_ != expectedPtr)
+		if (unpack(curr) != expectedPtr)
 			return false;
 
 		// If mark is already what we want, nothing to do
-		if (curr->marked_ == newMark)
+		if (((curr & MARK_BIT) != 0) == newMark)
 			return true;
 
-		// Prepare a new reference with the same Node* but new mark
-		LMarkableReference* desired = new LMarkableReference(curr->val_, newMark);
-
-		// Try to swap the reference atomically
-		return ref_.compare_exchange_strong(curr, desired, std::memory_order_acq_rel);
+		// Try to flip the mark bit atomically
+		return ref_.compare_exchange_weak(curr, pack(expectedPtr, newMark), std::memory_order_acq_rel, std::memory_order_relaxed);
 	}
 	LNodeBase* getReference() const {
-		return ref_.load(std::memory_order_acquire)->val_;
+		return unpack(ref_.load(LINK_LOAD_ORDER));
 	}
 
+	// Stays acquire in every mode: linkUpper's check after its CAS pairs
+	// with a remover's mark-then-search, and a plain load could pass the CAS.
 	bool getMark() const {
-		return ref_.load(std::memory_order_acquire)->marked_;
+		return (ref_.load(std::memory_order_acquire) & MARK_BIT) != 0;
 	}
 
 	void set(LNodeBase* val, bool mark) {
-		LMarkableReference* oldRef = ref_.load(std::memory_order_acquire);
-		LMarkableReference* newRef = new LMarkableReference(val, mark);
-		ref_.store(newRef, std::memory_order_release);
-		EpochManager::instance().retireLMarkable(oldRef, EpochManager::instance().currentEpoch());
+		ref_.store(pack(val, mark), std::memory_order_release);
 	}
 
+	// A failure only says the link changed: every caller reloads it before
+	// reading through it, so the failed load needs no order.
 	bool compareAndSet(LNodeBase* expectedPtr, LNodeBase* newPtr, bool expectedMark, bool newMark) {
-		LMarkableReference* curr = ref_.load(std::memory_order_acquire);
-
-		// If the current pointer or mark doesn't match expected, fail early
-		if (curr->val_ != expectedPtr || curr->marked_ != expectedMark)
-			return false;
-
-		// Prepare the new reference
-		LMarkableReference* desired = new LMarkableReference(newPtr, newMark);
-
-		// Attempt to atomically swap
-		if (ref_.compare_exchange_strong(curr, desired, std::memory_order_acq_rel)) {
-			// Success  retire the old reference
-			EpochManager::instance().retireLMarkable(curr, EpochManager::instance().currentEpoch());
-			return true;
-		}
-
-		// Failed  don't delete curr, someone else changed it
-		delete desired; // we have to delete what we allocated to avoid leaking
-		return false;
+		uintptr_t expected = pack(expectedPtr, expectedMark);
+		return ref_.compare_exchange_strong(expected, pack(newPtr, newMark), std::memory_order_acq_rel, std::memory_order_relaxed);
 	}
 };
 struct LNodeBase {
 	LMarkablePointer next;   // always points to NodeBase*
 	uint64_t key;           // keep the key here for traversal/comparison
 };
-template<typename T>
+// Alloc is the node allocator policy (NodeAllocator.h).
+template<typename T, typename Alloc = HeapNodeAllocator>
 struct LNode : LNodeBase {
+	static void* operator new(size_t size) { return Alloc::template allocate<LNode>(size, 0); }
+	static void operator delete(void* p) { Alloc::template deallocate<LNode>(p); }
+
 	T data;  // actual payload
 	LNode(uint64_t k, T d) {  // accept T by value
 		key = k;
@@ -109,127 +96,318 @@ struct LNode : LNodeBase {
 	}
 };
 
-template <typename T>
+// Where a key goes in a List: before(node) while node sorts ahead of it,
+// matches(node) for the first node that does not, if it holds the key.
+// List keys compare as plain uint64_t; LockFreeHashMap has its own probe.
+struct LKeyProbe {
+	uint64_t key;
+	bool before(const LNodeBase* node) const { return node->key < key; }
+	bool matches(const LNodeBase* node) const { return node->key == key; }
+};
+
+template <typename T, typename Reclaimer, typename Alloc, typename Stats>
+class LockFreeHashMap;
+
+// Reclaimer is the memory reclamation policy: EpochManager (default) or
+// HazardPointerManager from HazardPointers.h. Alloc is the node allocator
+// policy: HeapNodeAllocator (default) or SlabNodeAllocator. Stats is the
+// hot-path counter policy from Stats.h: NoStats (default) or ThreadStats<>.
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator, typename Stats = NoStats>
 class List {
+	using Guard = typename Reclaimer::Guard;
+	using Node = LNode<T, Alloc>;
+
 	struct Window {
 		LNodeBase* pred;
 		LNodeBase* curr;
 		Window(LNodeBase* myPred, LNodeBase* myCurr) {
 			pred = myPred, curr = myCurr;
 		}
-		static Window find(LNodeBase* head, uint64_t key) {
+		// pred and curr stay protected until the caller's read section ends.
+		// start is head or another node that is never removed.
+		static Window find(LNodeBase* start, uint64_t key) { return find(start, LKeyProbe{ key }); }
+		template <typename Probe>
+		static Window find(LNodeBase* start, const Probe& probe) {
+			Guard guard;
 			LNodeBase* pred = nullptr;
 			LNodeBase* curr = nullptr;
 			LNodeBase* succ = nullptr;
 			bool marked = false;
 			bool snip = false;
+			uint64_t steps = 0;
+			Stats::count(STAT_FIND);
 		RETRY:
 			while (true) {
-				pred = head;
-				curr = pred->next.getReference();
+				uint32_t hpPred = 0, hpCurr = 1, hpSucc = 2;
+				pred = start;
+				curr = guard.protect(hpCurr, pred->next, marked);
 				while (true) {
-					succ = curr->next.get(marked);
+					succ = guard.protect(hpSucc, curr->next, marked);
 					while (marked) {
 						snip = pred->next.compareAndSet(curr, succ, false, false);
-						if (!snip) goto RETRY;
+						if (!snip) {
+							Stats::count(STAT_CAS_FAIL);
+							Stats::count(STAT_FIND_RESTART);
+							goto RETRY;
+						}
+						Stats::count(STAT_UNLINK);
+						std::swap(hpCurr, hpSucc);
 						curr = succ;
-						succ = curr->next.get(marked);
+						succ = guard.protect(hpSucc, curr->next, marked);
 					}
-					if (curr->key >= key)
+					if (!probe.before(curr)) {
+						Stats::count(STAT_FIND_STEP, steps);
 						return Window(pred, curr);
+					}
+					uint32_t spare = hpPred;
+					hpPred = hpCurr;
+					hpCurr = hpSucc;
+					hpSucc = spare;
 					pred = curr;
 					curr = succ;
+					++steps;
 				}
 			}
 		}
 	};
 
+	// head and tail get cache lines of their own, so the links every
+	// operation starts from are never invalidated by a neighbouring object
+	static constexpr size_t SENTINEL_BYTES = (sizeof(Node) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+	static LNodeBase* createSentinel(uint64_t key) {
+		void* mem = ::operator new(SENTINEL_BYTES, std::align_val_t(CACHE_LINE));
+		return ::new (mem) Node(key, T()); // bypasses the Alloc policy
+	}
+	static void destroySentinel(LNodeBase* node) {
+		static_cast<Node*>(node)->~Node();
+		::operator delete(node, std::align_val_t(CACHE_LINE));
+	}
+
 	LNodeBase* head;
 	LNodeBase* tail;
+	// items added minus items removed, for size()
+	StripedCounter items;
 public:
+	// Forward iterator in key order, weakly consistent like
+	// SkipListMap::Iterator: marked nodes are skipped, and it is a read
+	// section of the thread that created it.
+	class Iterator {
+	public:
+		bool valid() const { return curr != list->tail; }
+		uint64_t key() const { return curr->key; }
+		// stays valid until the iterator moves
+		const T& value() const { return static_cast<Node*>(curr)->data; }
+		void next() {
+			if (valid())
+				settle(true);
+		}
+
+	private:
+		friend class List;
+		// Window::find() uses slots 0..2
+		static constexpr uint32_t HP_ITER = 3;
+		Guard guard;
+		List* list;
+		LNodeBase* curr = nullptr;
+		uint32_t hpCurr = HP_ITER, hpNext = HP_ITER + 1;
+
+		Iterator(List* list, uint64_t from) : list(list) {
+			curr = Window::find(list->head, from).curr;
+			guard.assign(hpCurr, curr);
+			settle(false);
+		}
+
+		void settle(bool visited) {
+			while (curr != list->tail) {
+				bool marked = false;
+				LNodeBase* succ = guard.protect(hpNext, curr->next, marked);
+				if (!marked && !visited)
+					return;
+				if (marked && !Reclaimer::TRAVERSE_MARKED) {
+					// succ may already be gone; find() snips curr
+					uint64_t key = curr->key;
+					curr = Window::find(list->head, key).curr;
+					guard.assign(hpCurr, curr);
+					visited = visited && curr->key == key && curr != list->tail;
+					continue;
+				}
+				std::swap(hpCurr, hpNext);
+				curr = succ;
+				visited = false;
+			}
+		}
+	};
+
+	Iterator iterator() { return Iterator(this, 0); }
+	// Starts at the first key >= from.
+	Iterator iterator(uint64_t from) { return Iterator(this, from); }
+
+	// Calls callback(key, value) for every item with lo <= key <= hi, in key
+	// order, and returns how many there were. One find() seeks to lo, then
+	// the scan follows next.
+	template <typename F>
+	size_t rangeScan(uint64_t lo, uint64_t hi, F&& callback) {
+		size_t visited = 0;
+		for (Iterator it(this, lo); it.valid() && it.key() <= hi; it.next()) {
+			callback(it.key(), it.value());
+			++visited;
+		}
+		return visited;
+	}
+
 	List() {
-		head = new LNode<T>(0, T());
-		tail = new LNode<T>(UINT64_MAX, T());
+		head = createSentinel(0);
+		tail = createSentinel(UINT64_MAX);
 		head->next.set(tail, false);
 	}
+	// Not thread-safe: no other thread may be using the list.
 	~List() {
-		delete head;
-		delete tail;
+		LNodeBase* curr = head->next.getReference();
+		while (curr != tail) {
+			LNodeBase* succ = curr->next.getReference();
+			delete static_cast<Node*>(curr);
+			curr = succ;
+		}
+		destroySentinel(head);
+		destroySentinel(tail);
 	}
 	bool add(uint64_t key, T item) {
-		EpochManager::instance().enterEpoch(thread_id);
-		while (true) {
-			Window window = Window::find(head, key);
-			LNode<T>* pred = static_cast<LNode<T>*>(window.pred);
-			LNode<T>* curr = static_cast<LNode<T>*>(window.curr);
+		bool inserted = false;
+		insertFrom(head, LKeyProbe{ key }, key, std::move(item), inserted);
+		if (inserted)
+			items.add(Reclaimer::threadId(), 1);
+		return inserted;
+	}
+	bool remove(uint64_t key) {
+		if (!removeFrom(head, LKeyProbe{ key }))
+			return false;
+		items.add(Reclaimer::threadId(), -1);
+		return true;
+	}
 
-			if (curr->key == key)
-				return false;
+	bool contains(uint64_t key) { return containsFrom(head, LKeyProbe{ key }); }
+	// Approximate while others update the list, see StripedCounter.
+	size_t size() const { return items.read(); }
+	// Totals of the Stats policy, shared by every list that uses it.
+	static StatsSnapshot stats() { return Stats::snapshot(); }
+	// Walks the list, O(n).
+	size_t exactSize() {
+		size_t n = 0;
+		for (Iterator it(this, 0); it.valid(); it.next())
+			++n;
+		return n;
+	}
+	// Returns a copy of the value, taken while the node is still protected.
+	std::optional<T> get(uint64_t key) { return getFrom(head, LKeyProbe{ key }); }
+
+private:
+	template <typename, typename, typename, typename> friend class LockFreeHashMap;
+
+	// The operations behind the public ones, searching from start (head, or
+	// a node that is never removed) for where probe says. LockFreeHashMap
+	// runs them from its bucket sentinels with its own probe.
+
+	// Links a node with key and item unless probe matches one; returns the
+	// node that holds the key, new or not.
+	template <typename Probe>
+	LNodeBase* insertFrom(LNodeBase* start, const Probe& probe, uint64_t key, T item, bool& inserted) {
+		Guard guard;
+		Node* node = nullptr;
+		while (true) {
+			Window window = Window::find(start, probe);
+			Node* pred = static_cast<Node*>(window.pred);
+			Node* curr = static_cast<Node*>(window.curr);
+
+			if (probe.matches(curr)) {
+				delete node; // never published
+				inserted = false;
+				return curr;
+			}
 
-			LNode<T>* node = new LNode<T>(key, item);
+			if (!node)
+				node = new Node(key, std::move(item));
 			node->next.set(curr, false);
 
 			if (pred->next.compareAndSet(curr, node, false, false)) {
-				EpochManager::instance().leaveEpoch(thread_id); // leave epoch
-				return true;
+				inserted = true;
+				return node;
 			}
+			Stats::count(STAT_CAS_FAIL);
 		}
 	}
-	bool remove(uint64_t key) {
-		EpochManager::instance().enterEpoch(thread_id); // enter epoch
+	template <typename Probe>
+	bool removeFrom(LNodeBase* start, const Probe& probe) {
+		Guard guard;
 		bool snip = false;
 		while (true) {
-			Window window = Window::find(head, key);
-			LNode<T>* pred = static_cast<LNode<T>*>(window.pred);
-			LNode<T>* curr = static_cast<LNode<T>*>(window.curr);
-			if (curr->key != key) {
-				EpochManager::instance().leaveEpoch(thread_id); // leave epoch
+			Window window = Window::find(start, probe);
+			Node* pred = static_cast<Node*>(window.pred);
+			Node* curr = static_cast<Node*>(window.curr);
+			if (!probe.matches(curr)) {
 				return false;
 			}
 			else {
-				LNode<T>* succ = curr->next.getReference();
-				snip = curr->next.attemptMark(succ, true);
-				if (!snip)
+				Node* succ = static_cast<Node*>(curr->next.getReference());
+				snip = curr->next.compareAndSet(succ, succ, false, true);
+				if (!snip) {
+					Stats::count(curr->next.getMark() ? STAT_MARK_LOST : STAT_CAS_FAIL);
 					continue;
-				pred->next.compareAndSet(curr, succ, false, false);
-				EpochManager::instance().retireLNodeBase(curr, EpochManager::instance().currentEpoch());
-				EpochManager::instance().leaveEpoch(thread_id); // leave epoch
+				}
+				// if the unlink loses, find() snips the marked node before we retire it
+				if (pred->next.compareAndSet(curr, succ, false, false)) {
+					Stats::count(STAT_UNLINK);
+				}
+				else {
+					Stats::count(STAT_CAS_FAIL);
+					Window::find(start, probe);
+				}
+				Reclaimer::instance().retireLNodeBase(curr, Reclaimer::instance().currentEpoch());
 				return true;
 			}
 		}
 	}
-
-	bool contains(uint64_t key) {
-		LNodeBase* curr = head;
+	template <typename Probe>
+	bool containsFrom(LNodeBase* start, const Probe& probe) {
+		Guard guard;
+		if constexpr (!Reclaimer::TRAVERSE_MARKED) {
+			// marked nodes cannot be stepped over, find() snips them
+			return probe.matches(Window::find(start, probe).curr);
+		}
+		LNodeBase* curr = start->next.getReference(); // start's key is not a real one
 
 		while (curr != nullptr) {
 			LNodeBase* succ = curr->next.getReference();
 			bool marked = curr->next.getMark();
 
-			if (curr->key >= key) {
-				return (curr->key == key && !marked);
+			if (!probe.before(curr)) {
+				return (probe.matches(curr) && !marked);
 			}
 
 			curr = succ;
 		}
 		return false;
 	}
-	T* get(uint64_t key) {
+	template <typename Probe>
+	std::optional<T> getFrom(LNodeBase* start, const Probe& probe) {
+		Guard guard;
+		if constexpr (!Reclaimer::TRAVERSE_MARKED) {
+			Window window = Window::find(start, probe);
+			if (!probe.matches(window.curr))
+				return std::nullopt;
+			return static_cast<Node*>(window.curr)->data;
+		}
 		bool marked = false;
-		LNodeBase* curr = head;
+		LNodeBase* curr = start->next.getReference();
 
-		while (curr->key < key) {
+		while (probe.before(curr)) {
 			curr = curr->next.get(marked);
 		}
 
-		if (curr->key == key && !marked) {
-			LNode<T>* typedNode = static_cast<LNode<T>*>(curr);
-			return &typedNode->data;  // return pointer to T
+		if (probe.matches(curr) && !curr->next.getMark()) {
+			Node* typedNode = static_cast<Node*>(curr);
+			return typedNode->data;  // copy of T
 		}
 
-		return nullptr;  // not found
+		return std::nullopt;  // not found
 	}
 };
-
-
-
@@ -0,0 +1,187 @@
+// Relaxed priority queue for many cores: a MultiQueue (Rihani, Sanders and
+// Dementiev) of independent SkipListMap shards. Adds go to one shard, and
+// popMin looks at the smallest key of two random shards and pops from the
+// one whose key is smaller ("power of two choices"). No line is shared by
+// all threads, so throughput keeps growing with the thread count, while
+// the two choices keep the rank error around O(shards) on average.
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "Skiplist.h"
+#include "Numa.h"
+
+constexpr int MULTIQUEUE_SHARDS_PER_THREAD = 2; // c in c x P shards
+constexpr int MULTIQUEUE_POP_ATTEMPTS = 8;      // two-choice pops before sweeping every shard
+constexpr uint32_t MULTIQUEUE_STICKY_OPS = 16;  // adds a thread sends to one shard under Sticky
+
+// Where add() puts an item. Random spreads every item, which gives the
+// lowest rank error. Sticky keeps a thread on one random shard for
+// MULTIQUEUE_STICKY_OPS adds before it moves on, so consecutive adds hit
+// the same warm towers. NumaLocal splits the shards into one group per
+// NUMA node: adds go to a random shard of the caller's node, and popMin
+// chooses among those too and steals from other nodes' groups only once
+// its own is empty. Pair it with NumaNodeAllocator so the items are in
+// local memory as well; the rank error then grows with the imbalance
+// between nodes.
+enum class MultiQueueInsert { Random, Sticky, NumaLocal };
+
+// Keys are unique per shard, not across the queue: add() fails only when
+// the shard it picked already holds the key, and remove, contains and get
+// try every shard (O(shards log n)), so use them sparingly. popMin and
+// popMinBatch are relaxed: they return one of the smallest items, and
+// nullopt / 0 only after a sweep found every shard empty. The last
+// template parameters are the shards' SkipListMap policies.
+template <typename K, typename T, typename Compare = std::less<K>, typename Reclaimer = EpochManager,
+	typename Alloc = HeapNodeAllocator, int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+class MultiQueueMap {
+	using Shard = SkipListMap<K, T, Compare, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
+
+	std::vector<std::unique_ptr<Shard>> shards;
+	Compare comp;
+	MultiQueueInsert insertPolicy;
+	size_t groups = 1;     // NUMA nodes under NumaLocal, otherwise 1
+	size_t groupSize = 0;  // shards per group; group g is [g * groupSize, (g + 1) * groupSize)
+
+public:
+	// shardCount 0 picks MULTIQUEUE_SHARDS_PER_THREAD per hardware thread.
+	// Under NumaLocal it is rounded up to a multiple of the node count.
+	explicit MultiQueueMap(int shardCount = 0, MultiQueueInsert insert = MultiQueueInsert::Random,
+		const Compare& comp = Compare()) : comp(comp), insertPolicy(insert) {
+		if (shardCount <= 0)
+			shardCount = MULTIQUEUE_SHARDS_PER_THREAD * int(std::max(1u, std::thread::hardware_concurrency()));
+		if (insert == MultiQueueInsert::NumaLocal) {
+			groups = size_t(numaNodeCount());
+			shardCount = int((size_t(shardCount) + groups - 1) / groups * groups);
+		}
+		groupSize = size_t(shardCount) / groups;
+		shards.reserve(size_t(shardCount));
+		for (int i = 0; i < shardCount; ++i)
+			shards.push_back(std::make_unique<Shard>(comp));
+	}
+	MultiQueueMap(const MultiQueueMap&) = delete;
+	MultiQueueMap& operator=(const MultiQueueMap&) = delete;
+
+	int shardCount() const { return int(shards.size()); }
+	int groupCount() const { return int(groups); }
+
+	bool add(const K& key, T x) { return shards[insertShard()]->add(key, std::move(x)); }
+	bool remove(const K& key) {
+		for (auto& shard : shards)
+			if (shard->remove(key))
+				return true;
+		return false;
+	}
+	bool contains(const K& key) {
+		for (auto& shard : shards)
+			if (shard->contains(key))
+				return true;
+		return false;
+	}
+	std::optional<T> get(const K& key) {
+		for (auto& shard : shards)
+			if (std::optional<T> val = shard->get(key))
+				return val;
+		return std::nullopt;
+	}
+
+	std::optional<T> popMin() {
+		size_t group = localGroup();
+		for (int attempt = 0; attempt < MULTIQUEUE_POP_ATTEMPTS; ++attempt) {
+			Shard* shard = chooseShard(group);
+			if (!shard)
+				break; // both empty, the queue may be nearly drained
+			if (std::optional<T> val = shard->popMin())
+				return val;
+		}
+		// the local group first, then the others
+		size_t start = size_t(threadRandom() >> 32) % groupSize;
+		for (size_t g = 0; g < groups; ++g)
+			for (size_t i = 0; i < groupSize; ++i)
+				if (std::optional<T> val = shardAt((group + g) % groups, start + i)->popMin())
+					return val;
+		return std::nullopt;
+	}
+	// Pops up to n items from the shard popMin would pick, see
+	// SkipListMap::popMinBatch; a batch never spans shards.
+	size_t popMinBatch(std::vector<T>& out, size_t n) {
+		size_t group = localGroup();
+		for (int attempt = 0; attempt < MULTIQUEUE_POP_ATTEMPTS; ++attempt) {
+			Shard* shard = chooseShard(group);
+			if (!shard)
+				break;
+			if (size_t got = shard->popMinBatch(out, n))
+				return got;
+		}
+		size_t start = size_t(threadRandom() >> 32) % groupSize;
+		for (size_t g = 0; g < groups; ++g)
+			for (size_t i = 0; i < groupSize; ++i)
+				if (size_t got = shardAt((group + g) % groups, start + i)->popMinBatch(out, n))
+					return got;
+		return 0;
+	}
+
+	bool empty() {
+		for (auto& shard : shards)
+			if (!shard->empty())
+				return false;
+		return true;
+	}
+	// Sum of the shards' approximate counts, see SkipListMap::size.
+	size_t size() const {
+		size_t n = 0;
+		for (auto& shard : shards)
+			n += shard->size();
+		return n;
+	}
+	size_t exactSize() {
+		size_t n = 0;
+		for (auto& shard : shards)
+			n += shard->exactSize();
+		return n;
+	}
+	static StatsSnapshot stats() { return Shard::stats(); }
+
+private:
+	size_t localGroup() const { return groups == 1 ? 0 : size_t(currentNumaNode()) % groups; }
+	// i-th shard of group, i taken modulo the group size
+	Shard* shardAt(size_t group, size_t i) const { return shards[group * groupSize + i % groupSize].get(); }
+
+	size_t insertShard() {
+		if (insertPolicy == MultiQueueInsert::Random)
+			return size_t(threadRandom() >> 32) % shards.size();
+		if (insertPolicy == MultiQueueInsert::NumaLocal)
+			return localGroup() * groupSize + size_t(threadRandom() >> 32) % groupSize;
+		static thread_local uint64_t home = 0;
+		static thread_local uint32_t left = 0;
+		if (left == 0) {
+			home = threadRandom() >> 32;
+			left = MULTIQUEUE_STICKY_OPS;
+		}
+		--left;
+		return size_t(home % shards.size());
+	}
+
+	// The one of two random shards of group with the smaller first key, or
+	// nullptr when both are empty.
+	Shard* chooseShard(size_t group) {
+		uint64_t r = threadRandom();
+		Shard* a = shardAt(group, size_t(r >> 32));
+		Shard* b = shardAt(group, size_t(r & 0xFFFFFFFFull));
+		std::optional<K> keyA = a->minKey();
+		if (a == b)
+			return keyA ? a : nullptr;
+		std::optional<K> keyB = b->minKey();
+		if (!keyA)
+			return keyB ? b : nullptr;
+		if (!keyB)
+			return a;
+		return comp(*keyB, *keyA) ? b : a;
+	}
+};
+
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator,
+	int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+using MultiQueue = MultiQueueMap<uint64_t, T, std::less<uint64_t>, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
@@ -0,0 +1,298 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "Epochs.h"
+#include "Numa.h"
+
+// Node allocator policies for SkipList and List. A policy provides
+//   template<typename Node> static void* allocate(size_t bytes, int height);
+//   template<typename Node> static void deallocate(void* p);
+// where height is the tower height of the node (0 for list nodes). The
+// reclaimers free nodes with plain delete, which the node types route back
+// to their policy, so reclaimed nodes go straight back to it.
+
+// Global operator new/delete, the default.
+struct HeapNodeAllocator {
+	template <typename Node>
+	static void* allocate(size_t bytes, int) { return ::operator new(bytes); }
+	template <typename Node>
+	static void deallocate(void* p) { ::operator delete(p); }
+};
+
+// Global operator new/delete on cache-line boundaries, sizes rounded up to
+// whole lines: nodes share no line with each other or with other heap
+// objects, and a node's first line holds its key and first links. Costs up
+// to one line of padding per node.
+struct CacheAlignedNodeAllocator {
+	template <typename Node>
+	static void* allocate(size_t bytes, int) {
+		return ::operator new((bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE, std::align_val_t(CACHE_LINE));
+	}
+	template <typename Node>
+	static void deallocate(void* p) { ::operator delete(p, std::align_val_t(CACHE_LINE)); }
+};
+
+constexpr size_t SLAB_BYTES = 16 * 1024;
+constexpr int SLAB_SIZE_CLASSES = 33;       // one per tower height 0..32
+constexpr size_t REMOTE_FREE_BATCH = 32;    // blocks per cross-thread handoff
+constexpr int REMOTE_FREE_OWNERS = 4;       // owners batched at a time per thread
+constexpr size_t NUMA_REGION_BYTES = 2 * 1024 * 1024; // node-local memory carved into slabs
+
+// Per-thread slab pool for one node type.
+// Every thread carves blocks of one size class (tower height) out of its
+// own SLAB_BYTES-aligned slabs; the slab header names the owning cache, so
+// a free finds its owner by masking the address. Frees of the thread's own
+// blocks go on a plain free list. Frees of other threads' blocks are
+// gathered into batches and handed over with one CAS onto the owner's
+// remote stack, which the owner drains when a free list runs dry.
+//
+// Caches outlive their threads: on exit a cache goes idle with all its
+// blocks and the next new thread adopts it. Slabs are never returned to
+// the system.
+//
+// With NumaLocal, slabs are carved out of NUMA_REGION_BYTES regions bound
+// to the node the allocating thread runs on, and a new thread adopts an
+// idle cache from its own node first. A block freed by a thread on another
+// node still goes back to its owner, so memory never changes node.
+template <typename Node, bool NumaLocal = false>
+class SlabPool {
+	struct FreeBlock { FreeBlock* next; };
+	struct Cache;
+	struct SlabHeader {
+		Cache* owner;   // nullptr for a dedicated oversized block
+		int sizeClass;
+	};
+	struct PendingFree {
+		Cache* owner;
+		FreeBlock* head;
+		FreeBlock* tail;
+		size_t count;
+	};
+	struct alignas(CACHE_LINE) Cache {
+		// the only field other threads write
+		alignas(CACHE_LINE) std::atomic<FreeBlock*> remoteFree{ nullptr };
+		alignas(CACHE_LINE) FreeBlock* freeList[SLAB_SIZE_CLASSES] = {};
+		char* bump[SLAB_SIZE_CLASSES] = {};
+		char* bumpEnd[SLAB_SIZE_CLASSES] = {};
+		PendingFree pending[REMOTE_FREE_OWNERS] = {};
+		int numaNode = 0; // of the thread that created it
+	};
+
+	static constexpr size_t BLOCK_ALIGN = alignof(Node) > alignof(std::max_align_t) ? alignof(Node) : alignof(std::max_align_t);
+	static constexpr size_t HEADER_BYTES = (sizeof(SlabHeader) + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+
+	// Thread exit hook. The cache pointer itself lives in a trivially
+	// destructible thread_local, so frees issued by later thread_local
+	// destructors (the reclaimers flush at exit) still find their way.
+	struct ThreadExit {
+		~ThreadExit() {
+			if (tlsCache) {
+				instance().releaseCache(tlsCache);
+				tlsCache = nullptr;
+			}
+			exited = true;
+		}
+	};
+	static inline thread_local Cache* tlsCache = nullptr;
+	static inline thread_local bool exited = false;
+
+public:
+	static SlabPool& instance() {
+		static SlabPool* inst = new SlabPool(); // never destroyed: blocks may outlive static teardown
+		return *inst;
+	}
+
+	void* allocate(size_t bytes, int height) {
+		size_t size = roundUp(bytes < sizeof(FreeBlock) ? sizeof(FreeBlock) : bytes);
+		if (height < 0 || height >= SLAB_SIZE_CLASSES || size > SLAB_BYTES - HEADER_BYTES)
+			return allocateLarge(size);
+
+		Cache* c = localCache();
+		FreeBlock* b = c->freeList[height];
+		if (!b) {
+			drainRemote(c);
+			b = c->freeList[height];
+		}
+		if (b) {
+			c->freeList[height] = b->next;
+			return b;
+		}
+		if (c->bump[height] == nullptr || size_t(c->bumpEnd[height] - c->bump[height]) < size)
+			newSlab(c, height);
+		void* p = c->bump[height];
+		c->bump[height] += size;
+		return p;
+	}
+
+	void deallocate(void* p) {
+		SlabHeader* slab = header(p);
+		if (!slab->owner) {
+			::operator delete(static_cast<void*>(slab), std::align_val_t(SLAB_BYTES));
+			return;
+		}
+		FreeBlock* b = static_cast<FreeBlock*>(p);
+		Cache* c = exited ? nullptr : localCache();
+		if (c == slab->owner) {
+			b->next = c->freeList[slab->sizeClass];
+			c->freeList[slab->sizeClass] = b;
+			return;
+		}
+		if (!c) {
+			pushRemote(slab->owner, b, b);
+			return;
+		}
+		PendingFree& batch = pendingFor(c, slab->owner);
+		b->next = batch.head;
+		batch.head = b;
+		if (!batch.tail)
+			batch.tail = b;
+		if (++batch.count >= REMOTE_FREE_BATCH)
+			flush(batch);
+	}
+
+private:
+	SlabPool() = default;
+
+	static size_t roundUp(size_t bytes) {
+		return (bytes + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+	}
+	static SlabHeader* header(void* p) {
+		return reinterpret_cast<SlabHeader*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(SLAB_BYTES) - 1));
+	}
+
+	Cache* localCache() {
+		if (!tlsCache) {
+			static thread_local ThreadExit exitHook;
+			(void)exitHook;
+			tlsCache = acquireCache();
+		}
+		return tlsCache;
+	}
+
+	void* allocateLarge(size_t size) {
+		char* mem = static_cast<char*>(::operator new(HEADER_BYTES + size, std::align_val_t(SLAB_BYTES)));
+		new (mem) SlabHeader{ nullptr, -1 };
+		return mem + HEADER_BYTES;
+	}
+
+	void newSlab(Cache* c, int sizeClass) {
+		char* mem = nullptr;
+		if (!NumaLocal)
+			mem = static_cast<char*>(::operator new(SLAB_BYTES, std::align_val_t(SLAB_BYTES)));
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (NumaLocal)
+				mem = numaSlab(currentNumaNode());
+			slabs_.push_back(mem);
+		}
+		new (mem) SlabHeader{ c, sizeClass };
+		c->bump[sizeClass] = mem + HEADER_BYTES;
+		c->bumpEnd[sizeClass] = mem + SLAB_BYTES;
+	}
+
+	// Next slab of node's region, under mutex_.
+	char* numaSlab(int node) {
+		if (size_t(regionEnd_[node] - regionNext_[node]) < SLAB_BYTES) {
+			char* region = static_cast<char*>(numaAllocate(NUMA_REGION_BYTES, node));
+			uintptr_t first = (reinterpret_cast<uintptr_t>(region) + SLAB_BYTES - 1) & ~(uintptr_t(SLAB_BYTES) - 1);
+			regionNext_[node] = reinterpret_cast<char*>(first);
+			regionEnd_[node] = region + NUMA_REGION_BYTES;
+		}
+		char* mem = regionNext_[node];
+		regionNext_[node] += SLAB_BYTES;
+		return mem;
+	}
+
+	static void drainRemote(Cache* c) {
+		FreeBlock* b = c->remoteFree.exchange(nullptr, std::memory_order_acquire);
+		while (b) {
+			FreeBlock* next = b->next;
+			int sizeClass = header(b)->sizeClass;
+			b->next = c->freeList[sizeClass];
+			c->freeList[sizeClass] = b;
+			b = next;
+		}
+	}
+
+	static void pushRemote(Cache* owner, FreeBlock* head, FreeBlock* tail) {
+		FreeBlock* old = owner->remoteFree.load(std::memory_order_relaxed);
+		do {
+			tail->next = old;
+		} while (!owner->remoteFree.compare_exchange_weak(old, head, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	static PendingFree& pendingFor(Cache* c, Cache* owner) {
+		PendingFree* fullest = &c->pending[0];
+		for (auto& batch : c->pending) {
+			if (batch.owner == owner)
+				return batch;
+			if (batch.count == 0) {
+				batch.owner = owner;
+				return batch;
+			}
+			if (batch.count > fullest->count)
+				fullest = &batch;
+		}
+		flush(*fullest);
+		fullest->owner = owner;
+		return *fullest;
+	}
+
+	static void flush(PendingFree& batch) {
+		if (batch.count)
+			pushRemote(batch.owner, batch.head, batch.tail);
+		batch = PendingFree{};
+	}
+
+	Cache* acquireCache() {
+		int node = NumaLocal ? currentNumaNode() : 0;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!idle_.empty()) {
+			size_t pick = idle_.size() - 1;
+			for (size_t i = 0; i < idle_.size(); ++i)
+				if (idle_[i]->numaNode == node)
+					pick = i;
+			Cache* c = idle_[pick];
+			idle_.erase(idle_.begin() + pick);
+			return c;
+		}
+		caches_.push_back(new Cache());
+		caches_.back()->numaNode = node;
+		return caches_.back();
+	}
+
+	void releaseCache(Cache* c) {
+		for (auto& batch : c->pending)
+			flush(batch);
+		std::lock_guard<std::mutex> lock(mutex_);
+		idle_.push_back(c);
+	}
+
+	std::mutex mutex_;
+	std::vector<Cache*> caches_;
+	std::vector<Cache*> idle_;
+	std::vector<char*> slabs_;
+	char* regionNext_[NUMA_MAX_NODES] = {};
+	char* regionEnd_[NUMA_MAX_NODES] = {};
+};
+
+// Per-thread slabs, one size class per tower height, batched cross-thread frees.
+struct SlabNodeAllocator {
+	template <typename Node>
+	static void* allocate(size_t bytes, int height) { return SlabPool<Node>::instance().allocate(bytes, height); }
+	template <typename Node>
+	static void deallocate(void* p) { SlabPool<Node>::instance().deallocate(p); }
+};
+
+// SlabNodeAllocator with slabs on the allocating thread's NUMA node, so
+// list nodes sit in the memory of the socket whose thread added them.
+struct NumaNodeAllocator {
+	template <typename Node>
+	static void* allocate(size_t bytes, int height) { return SlabPool<Node, true>::instance().allocate(bytes, height); }
+	template <typename Node>
+	static void deallocate(void* p) { SlabPool<Node, true>::instance().deallocate(p); }
+};
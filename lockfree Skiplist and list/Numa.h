@@ -0,0 +1,95 @@
+// NUMA topology and node-local memory for NumaNodeAllocator and
+// MultiQueue's per-node shards. Windows and Linux talk to the OS directly
+// (no libnuma); elsewhere there is one node and plain aligned new.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+constexpr int NUMA_MAX_NODES = 64;
+constexpr uint32_t NUMA_NODE_RECHECK = 1024; // calls between re-reading the current node
+
+// Number of NUMA nodes, at least 1 and at most NUMA_MAX_NODES.
+inline int numaNodeCount() {
+	static const int count = []() {
+		int n = 1;
+#ifdef _WIN32
+		ULONG highest = 0;
+		if (GetNumaHighestNodeNumber(&highest))
+			n = int(highest) + 1;
+#elif defined(__linux__)
+		// "0" or "0-3"; the nodes are numbered densely in practice
+		if (FILE* f = std::fopen("/sys/devices/system/node/possible", "r")) {
+			int first = 0, last = 0;
+			int got = std::fscanf(f, "%d-%d", &first, &last);
+			if (got == 2)
+				n = last + 1;
+			std::fclose(f);
+		}
+#endif
+		return n < 1 ? 1 : n > NUMA_MAX_NODES ? NUMA_MAX_NODES : n;
+	}();
+	return count;
+}
+
+// The node the calling thread is running on. Looking it up is a system
+// call on Linux, so the answer is cached per thread and refreshed every
+// NUMA_NODE_RECHECK calls: a thread that migrates is seen a little late.
+inline int currentNumaNode() {
+	static thread_local int node = -1;
+	static thread_local uint32_t calls = 0;
+	if (node >= 0 && ++calls < NUMA_NODE_RECHECK)
+		return node;
+	calls = 0;
+	int n = 0;
+#ifdef _WIN32
+	PROCESSOR_NUMBER proc;
+	GetCurrentProcessorNumberEx(&proc);
+	USHORT id = 0;
+	if (GetNumaProcessorNodeEx(&proc, &id))
+		n = int(id);
+#elif defined(__linux__) && defined(SYS_getcpu)
+	unsigned cpu = 0, id = 0;
+	if (syscall(SYS_getcpu, &cpu, &id, nullptr) == 0)
+		n = int(id);
+#endif
+	node = n < numaNodeCount() ? n : 0;
+	return node;
+}
+
+// bytes of memory placed on node, page aligned. Never returned to the
+// system: the callers carve long-lived slabs out of it.
+inline void* numaAllocate(size_t bytes, int node) {
+#ifdef _WIN32
+	void* p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, DWORD(node));
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+#elif defined(__linux__)
+	void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw std::bad_alloc();
+#ifdef SYS_mbind
+	// MPOL_PREFERRED: fall back to other nodes when this one is full.
+	// Without the call first touch would place most pages the same way.
+	constexpr int MPOL_PREFERRED_MODE = 1;
+	unsigned long mask = 1ul << node;
+	syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8, 0);
+#endif
+	return p;
+#else
+	(void)node;
+	return ::operator new(bytes, std::align_val_t(4096));
+#endif
+}
@@ -1,6 +1,7 @@
 // Lock-free concurrent skiplist with priority queue interface.
 // Ported from "The Art of Multiprocessor Programming" to C++.
-// Uses SNMarkablePointer with epoch-based memory reclamation.
+// Keys are any type with a Compare (SkipListMap), uint64_t for SkipList.
+// Uses SNMarkablePointer with pluggable memory reclamation (epochs by default).
 // Supports add, remove, contains, get, and popMin operations.
 #pragma once
 #define NOMINMAX
@@ -9,350 +10,621 @@
 #include <iostream>
 #include <limits>
 #include <cstdint>
+#include <cstddef>
 #include <thread>
-#include <cstdlib>  // for rand()
-#include <ctime>    // for seeding
+#include <chrono>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <utility>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
 #include "Epochs.h"
+#include "HazardPointers.h"
+#include "NodeAllocator.h"
+#include "Counters.h"
+#include "Stats.h"
+#include "Waiting.h"
 struct SNodeBase; // forward declaration
 
-// MarkableReference stores a Node* and a bool mark
-struct SNMarkableReference {
-	SNodeBase* val_;
-	bool marked_;
-
-	SNMarkableReference(SNodeBase* val = nullptr, bool mark = false)
-		: val_(val), marked_(mark) {
-	}
-};
-struct SNMarkableReferencePool {
-	std::vector<SNMarkableReference*> pool;
-
-	SNMarkableReference* acquire(SNMarkableReference* reuse = nullptr) {
-		if (reuse) return reuse;
-		if (!pool.empty()) {
-			SNMarkableReference* ref = pool.back();
-			pool.pop_back();
-			return ref;
-		}
-		return new SNMarkableReference();
-	}
-
-	void release(SNMarkableReference* ref) {
-		pool.push_back(ref);
-	}
-
-	~SNMarkableReferencePool() {
-		for (auto ref : pool) delete ref;
-		pool.clear();
-	}
-};
-
-// Thread-local instance  destructor called automatically when thread exits
-thread_local SNMarkableReferencePool snmarkablePool;
-
-// Hardcoded MarkablePointer for Node*
+// MarkablePointer packs a Node* and a bool mark into one word.
+// Nodes are at least 2-byte aligned, so bit 0 of the address is free to
+// carry the mark: a read is a single load and a CAS never allocates.
 struct SNMarkablePointer {
-	std::atomic<SNMarkableReference*> ref_;
+	static constexpr uintptr_t MARK_BIT = 1;
+	std::atomic<uintptr_t> ref_;
 
-	SNMarkablePointer() {
-		ref_.store(new SNMarkableReference(nullptr, false), std::memory_order_release);
+	static uintptr_t pack(SNodeBase* val, bool mark) {
+		return reinterpret_cast<uintptr_t>(val) | (mark ? MARK_BIT : 0);
 	}
-
-	SNMarkablePointer(SNodeBase* val, bool mark) {
-		ref_.store(new SNMarkableReference(val, mark), std::memory_order_release);
+	static SNodeBase* unpack(uintptr_t word) {
+		return reinterpret_cast<SNodeBase*>(word & ~MARK_BIT);
 	}
 
-	~SNMarkablePointer() {
-		delete ref_.load(std::memory_order_acquire);
-	}
+	SNMarkablePointer() : ref_(0) {}
+
+	SNMarkablePointer(SNodeBase* val, bool mark) : ref_(pack(val, mark)) {}
 
 	// get() like Java: returns the pointer and sets the mark
-	SNodeBase* get(bool& mark) const {
-		SNMarkableReference* temp = ref_.load(std::memory_order_acquire);
-		mark = temp->marked_;
-		return temp->val_;
+	SNodeBase* get(bool& mark, std::memory_order order = LINK_LOAD_ORDER) const {
+		uintptr_t word = ref_.load(order);
+		mark = (word & MARK_BIT) != 0;
+		return unpack(word);
 	}
+	// May fail spuriously; callers loop until the mark is seen.
 	bool attemptMark(SNodeBase* expectedPtr, bool newMark) {
-		SNMarkableReference* curr = ref_.load(std::memory_order_acquire);
+		uintptr_t curr = ref_.load(std::memory_order_relaxed);
 
 		// Only attempt if the pointer part matches expectedPtr
-		if (curr->val_ != expectedPtr)
+		if (unpack(curr) != expectedPtr)
 			return false;
 
 		// If mark is already what we want, nothing to do
-		if (curr->marked_ == newMark)
+		if (((curr & MARK_BIT) != 0) == newMark)
 			return true;
 
-		// Prepare a new reference with the same Node* but new mark
-		SNMarkableReference* desired = new SNMarkableReference(curr->val_, newMark);
-
-		// Try to swap the reference atomically
-		return ref_.compare_exchange_strong(curr, desired, std::memory_order_acq_rel);
+		// Try to flip the mark bit atomically
+		return ref_.compare_exchange_weak(curr, pack(expectedPtr, newMark), std::memory_order_acq_rel, std::memory_order_relaxed);
 	}
 	SNodeBase* getReference() const {
-		return ref_.load(std::memory_order_acquire)->val_;
+		return unpack(ref_.load(LINK_LOAD_ORDER));
 	}
 
+	// Stays acquire in every mode: linkUpper's check after its CAS pairs
+	// with a remover's mark-then-search, and a plain load could pass the CAS.
 	bool getMark() const {
-		return ref_.load(std::memory_order_acquire)->marked_;
+		return (ref_.load(std::memory_order_acquire) & MARK_BIT) != 0;
 	}
 
 	void set(SNodeBase* val, bool mark) {
-		SNMarkableReference* oldRef = ref_.load(std::memory_order_acquire);
-		SNMarkableReference* newRef = snmarkablePool.acquire();
-		newRef->val_ = val;
-		newRef->marked_ = mark;
-		ref_.store(newRef, std::memory_order_release);
-		EpochManager::instance().retireSNMarkable(oldRef, EpochManager::instance().currentEpoch());
+		ref_.store(pack(val, mark), std::memory_order_release);
 	}
 
+	// A failure only says the link changed: every caller reloads it before
+	// reading through it, so the failed load needs no order.
 	bool compareAndSet(SNodeBase* expectedPtr, SNodeBase* newPtr, bool expectedMark, bool newMark) {
-		SNMarkableReference* curr = ref_.load(std::memory_order_acquire);
+		uintptr_t expected = pack(expectedPtr, expectedMark);
+		return ref_.compare_exchange_strong(expected, pack(newPtr, newMark), std::memory_order_acq_rel, std::memory_order_relaxed);
+	}
+};
 
-		// If the current pointer or mark doesn't match expected, fail early
-		if (curr->val_ != expectedPtr || curr->marked_ != expectedMark)
-			return false;
+const int MAX_LEVEL = 16;
 
-		// Prepare the new reference
+// Index of the lowest set bit, 64 for 0.
+inline int countTrailingZeros(uint64_t x) {
+	if (x == 0)
+		return 64;
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return int(index);
+#else
+	return __builtin_ctzll(x);
+#endif
+}
 
-		SNMarkableReference* desired = snmarkablePool.acquire();
-		desired->val_ = newPtr;
-		desired->marked_ = newMark;
-		// Attempt to atomically swap
-		if (ref_.compare_exchange_strong(curr, desired, std::memory_order_acq_rel)) {
-			// Success  retire the old reference
-			EpochManager::instance().retireSNMarkable(curr, EpochManager::instance().currentEpoch());
-			return true;
+// xorshift64*, one generator per thread, seeded from the address of its
+// state so every thread draws a different sequence. Shared by SkipListMap,
+// MultiQueueMap and EliminationSkipListMap.
+inline uint64_t threadRandom() {
+	static thread_local uint64_t state = 0;
+	if (state == 0)
+		state = (uint64_t(reinterpret_cast<uintptr_t>(&state)) ^ 0x9E3779B97F4A7C15ull) | 1;
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1Dull;
+}
+
+// Asks for p's cache line ahead of a read. Only a hint: it never faults,
+// so any address will do.
+inline void prefetchRead(const void* p) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(_MSC_VER)
+	__prefetch(p);
+#else
+	__builtin_prefetch(p, 0, 3);
+#endif
+}
+
+// The part of a node links point at: no key, so SNMarkablePointer and the
+// sentinels do not depend on the key type.
+struct SNodeBase {
+	int topLevel = 0;
+	// Two parties must let go of a node before it can be retired: the
+	// inserter once it stops linking upper levels, and the thread whose
+	// bottom-level mark removed it. Whoever drops the last reference has
+	// seen the node unlinked everywhere and retires it.
+	std::atomic<int> refs{ 2 };
+	// Forward tower, topLevel + 1 links stored inline right after the
+	// header. Only next[0] is declared; the allocation sizes the rest.
+	SNMarkablePointer next[1];
+
+	void initTower(int height) {
+		topLevel = height;
+		for (int i = 1; i <= height; i++) {
+			new (&next[i]) SNMarkablePointer(); // next[0] is a real member
 		}
+	}
 
-		// Failed  don't delete curr, someone else changed it
-		snmarkablePool.release(desired);
-		return false;
+	// head/tail: a bare tower, no key and no value. They compare by address,
+	// so every key is usable. Each gets whole cache lines of its own, and the
+	// header is placed so next[1] starts a new line: head->next[0] is CASed
+	// by every popMin, the links above it are read by every search, and
+	// neither should invalidate the other or a neighbouring object.
+	static constexpr size_t sentinelOffset() { return (CACHE_LINE - sizeof(SNodeBase) % CACHE_LINE) % CACHE_LINE; }
+	static SNodeBase* createSentinel(int height) {
+		size_t bytes = sentinelOffset() + sizeof(SNodeBase) + height * sizeof(SNMarkablePointer);
+		bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+		char* mem = static_cast<char*>(::operator new(bytes, std::align_val_t(CACHE_LINE)));
+		SNodeBase* node = new (mem + sentinelOffset()) SNodeBase();
+		node->initTower(height);
+		return node;
+	}
+	static void destroySentinel(SNodeBase* node) {
+		node->~SNodeBase();
+		::operator delete(reinterpret_cast<char*>(node) - sentinelOffset(), std::align_val_t(CACHE_LINE));
 	}
 };
 
-const int MAX_LEVEL = 16;
-
-struct SNodeBase {
-	SNMarkablePointer* next;
-	uint64_t key;           // keep the key here for traversal/comparison
-	void* data;
-	int topLevel;
+template <typename K>
+struct SNodeKey {
+	K key;
 };
-template <typename T>
-struct SNode : SNodeBase {
-	SNode(uint64_t key) {
-		this->key = key;
-		this->topLevel = MAX_LEVEL;
-		next = new SNMarkablePointer[MAX_LEVEL + 1];
-		for (int i = 0; i <= MAX_LEVEL; i++) {
-			next[i].set(nullptr, false); // Initialize everything
-		}
-		this->data = nullptr;   // store in base::data
+
+// Alloc is the node allocator policy (NodeAllocator.h).
+// Layout: [key | SNodeBase header | next[0..topLevel] | T]. The key is the
+// first base so it sits right before the links it is compared next to;
+// SNodeBase must stay the last subobject for the inline tower. Converting
+// between SNodeBase* and SNode* moves the pointer by the key, so it is
+// always a static_cast. With CacheAlignedNodeAllocator the key and
+// next[0], the fields every search step reads, share the node's first
+// cache line whenever sizeof(K) + sizeof(SNodeBase) <= CACHE_LINE.
+template <typename K, typename T, typename Alloc = HeapNodeAllocator>
+struct alignas(alignof(T) > alignof(SNodeBase) ? alignof(T) : alignof(SNodeBase)) SNode : SNodeKey<K>, SNodeBase {
+	static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned values are not supported");
+	static_assert(alignof(K) <= alignof(std::max_align_t), "over-aligned keys are not supported");
+
+	static size_t valueOffset(int height) {
+		size_t end = sizeof(SNode) + height * sizeof(SNMarkablePointer);
+		return (end + alignof(T) - 1) / alignof(T) * alignof(T);
 	}
 
-	SNode(uint64_t key, int height) {
-		this->key = key;
-		this->topLevel = height;
-		next = new SNMarkablePointer[MAX_LEVEL + 1];
-		for (int i = 0; i <= MAX_LEVEL; i++) {
-			next[i].set(nullptr, false); // Initialize everything
-		}
-		this->data = nullptr;   // store in base::data
+	// Nodes are allocated with their tower and value: new (height) SNode(...)
+	static void* operator new(size_t, int height) {
+		return Alloc::template allocate<SNode>(valueOffset(height) + sizeof(T), height);
 	}
+	static void operator delete(void* p) { Alloc::template deallocate<SNode>(p); }
+	static void operator delete(void* p, int) { Alloc::template deallocate<SNode>(p); }
 
-	SNode(uint64_t key, T* value, int height) {
-		this->key = key;
-		this->topLevel = height;
-		next = new SNMarkablePointer[MAX_LEVEL + 1];
-		for (int i = 0; i <= MAX_LEVEL; i++) {
-			next[i].set(nullptr, false); // Initialize everything
-		}
-		this->data = static_cast<void*>(value);  // store pointer as integer
+	template <typename... Args>
+	static SNode* create(const K& key, int height, Args&&... args) {
+		return new (height) SNode(key, height, std::forward<Args>(args)...);
 	}
 
-	~SNode() {
-		delete[] next;                     // free the array
-		delete static_cast<T*>(this->data);  // delete the object
+	template <typename... Args>
+	SNode(const K& key, int height, Args&&... args) : SNodeKey<K>{ key } {
+		initTower(height);
+		new (value()) T(std::forward<Args>(args)...);
 	}
+
+	~SNode() { value()->~T(); }
+	T* value() { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + valueOffset(topLevel)); }
 	int height() const { return topLevel; }
 };
-template <typename T>
-class SkipList {
+
+// Skiplist ordered by K under Compare (a strict weak order, like
+// std::map's), holding one T per key. SkipList below is the uint64_t-keyed
+// version.
+// Reclaimer is the memory reclamation policy: EpochManager (default) or
+// HazardPointerManager from HazardPointers.h. Alloc is the node allocator
+// policy: HeapNodeAllocator (default) or SlabNodeAllocator.
+// MaxLevel is the top tower index and a node reaches each next level with
+// p = 1 / 2^LogInvP: the defaults suit about 2^16 keys, LogInvP = 2
+// (p = 0.25) halves the links per node for tables sized for memory.
+// Stats is the hot-path counter policy (Stats.h): NoStats (default) or
+// ThreadStats<>.
+template <typename K, typename T, typename Compare = std::less<K>, typename Reclaimer = EpochManager,
+	typename Alloc = HeapNodeAllocator, int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+class SkipListMap {
+	static_assert(MaxLevel >= 1 && LogInvP >= 1 && LogInvP < 64, "bad level distribution");
+	// popMin, popMinBatch and updateKey copy the value rather than move it:
+	// a get() or an iterator that reached the node before it was marked may
+	// still be reading it, and a move would race with that read.
+	static_assert(std::is_copy_constructible_v<T>, "SkipListMap values must be copy constructible");
+	using Guard = typename Reclaimer::Guard;
+	using Node = SNode<K, T, Alloc>;
+
+	// hazard slots: preds/succs of the last find() plus traversal scratch
+	static constexpr uint32_t HP_PREDS = 0;
+	static constexpr uint32_t HP_SUCCS = HP_PREDS + MaxLevel + 1;
+	static constexpr uint32_t HP_FIND = HP_SUCCS + MaxLevel + 1; // 3 rotating slots
+	static constexpr uint32_t HP_POP = HP_FIND + 3;
+	static constexpr uint32_t HP_SPRAY = HP_POP + 1; // 2 rotating slots, also used by popMinBatch
+	static constexpr uint32_t HP_ITER = HP_SPRAY + 2; // 2 rotating slots
+	static constexpr uint32_t HP_MIN = HP_ITER + 2; // minKey, which may run while this thread iterates
+	static_assert(HP_MIN < HAZARDS_PER_THREAD, "not enough hazard slots for MaxLevel");
+
+	// relaxed popMin failures before falling back to the strict one
+	static constexpr int SPRAY_ATTEMPTS = 4;
+	// nodes popMinBatch claims before unlinking them
+	static constexpr size_t POP_BATCH_RUN = 64;
+	// popMinWait's polling before it parks, adapted per thread in this range
+	static constexpr int POP_WAIT_SPIN_MIN = 16;
+	static constexpr int POP_WAIT_SPIN_MAX = 4096;
+	// searches getMany keeps in flight, and keys per read section
+	static constexpr int GET_MANY_LANES = 16;
+	static constexpr size_t GET_MANY_CHUNK = 256;
+	// a node's key starts this far before its SNodeBase, in the usual base
+	// layout; only prefetchStep relies on it
+	static constexpr size_t KEY_BACK = (sizeof(SNodeKey<K>) + alignof(SNodeBase) - 1) / alignof(SNodeBase) * alignof(SNodeBase);
+
 	SNodeBase* head;
 	SNodeBase* tail;
+	Compare comp;
+	// Highest level any node has been linked at. Only ever raised, by an
+	// insert before it links that high, so searches start here instead of
+	// at MaxLevel and skip the levels that only hold head -> tail.
+	std::atomic<int> currentLevel{ 0 };
+	// spray walk shape, 0/0 for strict popMin (see setRelaxedPopMin)
+	int sprayThreads = 0;
+	int sprayHeight = 0;
+	int sprayJump = 0;
+	// items added minus items removed, for size()
+	StripedCounter items;
+	// popMinWait parking: sleepers count the parked consumers, and adds bump
+	// wakeSeq and wake them only when there are any. Own line, so the adds'
+	// check is a read of a line that is only written around a sleep.
+	struct alignas(CACHE_LINE) WaitWord {
+		std::atomic<uint32_t> sleepers{ 0 };
+		std::atomic<uint32_t> wakeSeq{ 0 };
+	} waiting;
 
 public:
-	SkipList() {
-		head = new SNode<T>(0, nullptr, MAX_LEVEL);
-		tail = new SNode<T>(UINT64_MAX, nullptr, MAX_LEVEL);
-		for (int i = 0; i <= MAX_LEVEL; ++i)
-			head->next[i].set(tail, false);
-	}
+	// Per-thread search hint for keys that arrive in order (timestamps,
+	// sequence ids): the preds of the thread's last operation. Passing it to
+	// add/remove/contains makes the search climb from the lowest of them
+	// that is still valid and descend from there (see find), so a key d
+	// items from the previous one costs O(log d) levels and steps instead of
+	// O(log n); higher levels are only searched up to the node being linked
+	// or unlinked. A finger belongs to one thread and one list. It only
+	// outlives the operation under EpochManager, and only while the thread
+	// is pinned in the same epoch again; otherwise the search starts from
+	// head.
+	struct Finger {
+		SNodeBase* preds[MaxLevel + 1] = {};
+		uint64_t epoch = UINT64_MAX;
+	};
 
-	~SkipList() {
-		delete head;
-		delete tail;
-	}
+	// Forward iterator over the bottom level, in key order. Weakly
+	// consistent: it returns every item present for its whole walk, none
+	// removed before it got there, and items added or removed meanwhile
+	// either way; marked nodes are skipped. The iterator is a read section
+	// of the thread that created it, so use and destroy it on that thread,
+	// one at a time, and keep it short under EpochManager: nothing retired
+	// after it started is freed until it ends.
+	class Iterator {
+	public:
+		bool valid() const { return curr != list->tail; }
+		const K& key() const { return keyOf(curr); }
+		// stays valid until the iterator moves
+		const T& value() const { return *static_cast<Node*>(curr)->value(); }
+		void next() {
+			if (valid())
+				settle(true);
+		}
 
-	bool find(uint64_t key, SNode<T>* preds[MAX_LEVEL + 1], SNode<T>* succs[MAX_LEVEL + 1]){
-		EpochManager::instance().enterEpoch(thread_id);
-		int bottomLevel = 0;
-		bool marked = false;
-		SNodeBase* pred = nullptr;
+	private:
+		friend class SkipListMap;
+		Guard guard;
+		SkipListMap* list;
 		SNodeBase* curr = nullptr;
-		SNodeBase* succ = nullptr;
+		uint32_t hpCurr = HP_ITER, hpNext = HP_ITER + 1;
 
-	RETRY:
-		while (true) {
-			pred = head;
-			for (int level = MAX_LEVEL; level >= 0; --level) {
-				pred = head;
-				curr = pred->next[level].getReference();
-				while (true) {
-					bool marked = false;
-					succ = (level <= curr->topLevel) ? curr->next[level].get(marked) : tail;
+		explicit Iterator(SkipListMap* list) : list(list) {
+			bool marked = false;
+			curr = guard.protect(hpCurr, list->head->next[0], marked);
+			settle(false);
+		}
+		Iterator(SkipListMap* list, const K& from) : list(list) {
+			SNodeBase* preds[MaxLevel + 1];
+			SNodeBase* succs[MaxLevel + 1];
+			list->find(from, preds, succs);
+			curr = succs[0];
+			guard.assign(hpCurr, curr);
+			settle(false);
+		}
 
-					while (marked) {
-						// Try to physically remove curr
-						if (!pred->next[level].compareAndSet(curr, succ, false, false))
-							goto RETRY; // someone changed pred, restart whole search
+		// Moves curr to the first live node, past curr itself if visited
+		// (and past any newer copy of its key).
+		void settle(bool visited) {
+			while (curr != list->tail) {
+				bool marked = false;
+				SNodeBase* succ = guard.protect(hpNext, curr->next[0], marked);
+				if (!marked && !visited)
+					return;
+				if (marked && !Reclaimer::TRAVERSE_MARKED) {
+					// succ may already be gone: find() unlinks curr and lands
+					// on the first live node from its key on
+					SNodeBase* preds[MaxLevel + 1];
+					SNodeBase* succs[MaxLevel + 1];
+					const K& key = keyOf(curr);
+					list->find(key, preds, succs);
+					visited = visited && list->matches(succs[0], key);
+					curr = succs[0];
+					guard.assign(hpCurr, curr);
+					continue;
+				}
+				std::swap(hpCurr, hpNext);
+				curr = succ;
+				visited = false;
+			}
+		}
+	};
 
-						curr = pred->next[level].getReference();
-						if (!curr) break;
-						succ = (level <= curr->topLevel) ? curr->next[level].get(marked) : tail;
-					}
-				
-					if (curr->key < key) {
-						pred = curr;
-						curr = succ; // advance curr AFTER pred is updated
-					}
-					else {
-						break;
-					}
-			
+	explicit SkipListMap(const Compare& comp = Compare()) : comp(comp) {
+		head = SNodeBase::createSentinel(MaxLevel);
+		tail = SNodeBase::createSentinel(MaxLevel);
+		for (int i = 0; i <= MaxLevel; ++i)
+			head->next[i].set(tail, false);
+	}
+
+	// Not thread-safe: no other thread may be using the list.
+	~SkipListMap() {
+		SNodeBase* curr = head->next[0].getReference();
+		while (curr != tail) {
+			SNodeBase* succ = curr->next[0].getReference();
+			delete static_cast<Node*>(curr);
+			curr = succ;
+		}
+		SNodeBase::destroySentinel(head);
+		SNodeBase::destroySentinel(tail);
+	}
+
+	// Fills preds/succs for every level and physically unlinks any marked
+	// node on the way. Nests inside the caller's read section; preds/succs
+	// stay protected until that section ends.
+	// hints, if given, are the preds of an earlier find() in the same read
+	// section (preds itself is fine), and make it a finger search: it climbs
+	// from level 0 to the first hint that is still linked, before key and
+	// followed by a node that is not, and descends from there, so for keys
+	// d apart it visits O(log d) levels instead of all of them. Then only
+	// levels up to need (and the one it started from) are filled in, each
+	// from its own hint; the ones above keep what they held. Without a
+	// usable hint it searches from head and fills them all.
+	bool find(const K& key, SNodeBase* preds[MaxLevel + 1], SNodeBase* succs[MaxLevel + 1], SNodeBase* const* hints = nullptr,
+		int need = MaxLevel) {
+		Guard guard;
+		uint32_t hp[3] = { HP_FIND, HP_FIND + 1, HP_FIND + 2 }; // pred, curr, succ
+		uint64_t steps = 0;
+		Stats::count(STAT_FIND);
+
+		if (!hints || !fingerSearch(guard, hp, key, preds, succs, hints, need, steps)) {
+			while (true) {
+				int top = currentLevel.load(std::memory_order_acquire);
+				for (int level = MaxLevel; level > top; --level) {
+					preds[level] = head;
+					succs[level] = tail;
 				}
-				preds[level] = reinterpret_cast<SNode<T>*>(pred);
-				succs[level] = reinterpret_cast<SNode<T>*>(curr);
+				if (descend(guard, hp, key, head, top, preds, succs, nullptr, steps))
+					break;
 			}
-			EpochManager::instance().leaveEpoch(thread_id);
-			return (curr->key == key);
 		}
+		Stats::count(STAT_FIND_STEP, steps);
+		return matches(succs[0], key);
 	}
-	bool add(int key, T x) {
-		EpochManager::instance().enterEpoch(thread_id);
+	bool add(const K& key, T x) {
+		Guard guard;
 		int topLevel = randomLevel();
-		const int bottomLevel = 0;
-		SNode<T>* newNode = nullptr;
+		raiseLevel(topLevel);
 
 		// Use fixed-size arrays to avoid dynamic allocation
-		SNode<T>* preds[MAX_LEVEL + 1] = {};
-		SNode<T>* succs[MAX_LEVEL + 1] = {};
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
 
-		while (true) {
-			bool found = find(key, preds, succs);
-			if (found) {
-				EpochManager::instance().leaveEpoch(thread_id);
-				return false; // Key already exists
-			}
+		if (find(key, preds, succs))
+			return false; // Key already exists
 
-			// Allocate node once per attempt
-			if (!newNode) {
-				newNode = new SNode<T>(key, new T(x), topLevel);
-			}
+		Node* newNode = Node::create(key, topLevel, std::move(x));
+		if (!link(newNode, preds, succs)) {
+			delete newNode; // never published
+			return false;
+		}
+		counted(1);
+		wakeWaiters();
+		return true; // Node successfully inserted
+	}
 
-			// Step 1: Initialize next pointers of newNode to successors
-			for (int level = bottomLevel; level <= topLevel; ++level) {
-				newNode->next[level].set(succs[level], false);
+	bool add(const K& key, T x, Finger& finger) {
+		Guard guard;
+		SNodeBase* succs[MaxLevel + 1] = {};
+		bool added = false;
+		int topLevel = randomLevel();
+		raiseLevel(topLevel);
+		if (!find(key, finger.preds, succs, fingerHints(finger), topLevel)) {
+			Node* newNode = Node::create(key, topLevel, std::move(x));
+			added = link(newNode, finger.preds, succs);
+			if (added) {
+				counted(1);
+				wakeWaiters();
 			}
-
-			// Step 2: Insert at bottom level first
-			SNode<T>* pred = preds[bottomLevel];
-			SNode<T>* succ = succs[bottomLevel];
-
-			if (!pred->next[bottomLevel].compareAndSet(succ, newNode, false, false)) {
-				// CAS failed, retry from scratch
-				continue;
+			else {
+				delete newNode;
 			}
+		}
+		stampFinger(finger);
+		return added;
+	}
 
-			// Step 3: Insert at higher levels
-			for (int level = bottomLevel + 1; level <= topLevel; ++level) {
-				while (true) {
-					pred = preds[level];
-					succ = succs[level];
-
-					if (pred->next[level].compareAndSet(succ, newNode, false, false))
-						break; // Success
+	// Inserts a range of (key, value) pairs sorted by key, e.g. a
+	// std::vector<std::pair<K, T>>, and returns how many were new.
+	// Into an empty list the towers are built bottom-up in one pass and
+	// published with one CAS per level; otherwise, or if someone else adds
+	// first, each key is inserted with a find() that starts from the preds
+	// of the key before it. Unsorted input is still inserted, just slower;
+	// a duplicate key keeps the first value.
+	template <typename It>
+	size_t addRange(It first, It last) {
+		Guard guard;
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
+		size_t added = 0;
 
-					// Retry find if CAS fails
-					find(key, preds, succs);
+		if (first != last && head->next[0].getReference() == tail) {
+			std::vector<Node*> nodes;
+			SNodeBase* firstAt[MaxLevel + 1];
+			if (buildRange(first, last, nodes, firstAt)) {
+				linkRange(nodes, firstAt, preds, succs);
+				added = nodes.size();
+			}
+			else {
+				// lost the race for the empty list: the built nodes go in one by one
+				bool hinted = false;
+				for (Node* node : nodes) {
+					if (!find(node->key, preds, succs, hinted ? preds : nullptr, node->topLevel) && link(node, preds, succs))
+						++added;
+					else
+						delete node;
+					hinted = true;
 				}
 			}
+		}
 
-			EpochManager::instance().leaveEpoch(thread_id);
-			return true; // Node successfully inserted
+		bool hinted = false;
+		for (; first != last; ++first) {
+			const K& key = first->first;
+			int topLevel = randomLevel();
+			raiseLevel(topLevel);
+			bool found = find(key, preds, succs, hinted ? preds : nullptr, topLevel);
+			hinted = true;
+			if (found)
+				continue;
+			Node* newNode = Node::create(key, topLevel, first->second);
+			if (link(newNode, preds, succs))
+				++added;
+			else
+				delete newNode;
 		}
+		counted(int64_t(added));
+		if (added)
+			wakeWaiters();
+		return added;
 	}
 
-	bool remove(uint64_t key) {
-		EpochManager::instance().enterEpoch(thread_id);
+	bool remove(const K& key) {
+		Guard guard;
 		int bottomLevel = 0;
-		SNode<T>* preds[MAX_LEVEL + 1] = {};
-		SNode<T>* succs[MAX_LEVEL + 1] = {};
-	RETRY_REMOVE:
-		while (true) {
-			bool found = find(key, preds, succs);
-			if (!found) {
-				EpochManager::instance().leaveEpoch(thread_id); // <- exit before return
-				return false;
-			}
-			SNode<T>* nodeToRemove = succs[bottomLevel];
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
 
-			// Step 1: Mark higher-level links
-			for (int level = nodeToRemove->topLevel; level > bottomLevel; --level) {
-				bool marked = false;
-				SNode<T>* succ = nullptr;
-				do {
-					succ = reinterpret_cast<SNode<T>*>(nodeToRemove->next[level].get(marked));
-					if (marked) break; // already marked
-				} while (!nodeToRemove->next[level].attemptMark(succ, true));
-			}
+		bool found = find(key, preds, succs);
+		if (!found)
+			return false;
+		SNodeBase* nodeToRemove = succs[bottomLevel];
+		if (!markNode(nodeToRemove))
+			return false; // already removed by another thread
 
-			// Step 2: Mark bottom-level link using CAS
-			bool marked = false;
-			SNode<T>* succ = nullptr;
-			do {
-				succ = reinterpret_cast<SNode<T>*>(nodeToRemove->next[bottomLevel].get(marked));
-				if (marked) return false; // already removed by another thread
-			} while (!nodeToRemove->next[bottomLevel].compareAndSet(succ, succ, false, true));
-
-			// Step 3: Link predecessors to successor at bottom level
-			for (int level = bottomLevel; level <= nodeToRemove->topLevel; ++level) {
-				SNode<T>* pred = preds[level];
-				SNode<T>* succ = reinterpret_cast<SNode<T>*>(nodeToRemove->next[level].get(marked));
-
-				while (!pred->next[level].compareAndSet(nodeToRemove, succ, false, false)) {
-					// Instead of find(key), just restart remove from top
-					goto RETRY_REMOVE;
-				}
+		// Node is logically removed; find() unlinks it from every level.
+		// Searched by its own key: a key that only matches it (a multimap
+		// probe) can stop at an equal node linked in front of it since.
+		find(static_cast<Node*>(nodeToRemove)->key, preds, succs);
+		release(nodeToRemove);
+		counted(-1);
+		return true;
+	}
+
+	bool remove(const K& key, Finger& finger) {
+		Guard guard;
+		SNodeBase* succs[MaxLevel + 1] = {};
+		bool removed = false;
+		if (find(key, finger.preds, succs, fingerHints(finger), 0)) {
+			SNodeBase* nodeToRemove = succs[0];
+			removed = markNode(nodeToRemove);
+			if (removed) {
+				find(static_cast<Node*>(nodeToRemove)->key, finger.preds, succs, finger.preds, nodeToRemove->topLevel);
+				release(nodeToRemove);
+				counted(-1);
 			}
+		}
+		stampFinger(finger);
+		return removed;
+	}
 
-			EpochManager::instance().retirePtr(static_cast<SNode<T>*>(nodeToRemove), EpochManager::instance().currentEpoch());
-			// Node logically and physically removed
-			EpochManager::instance().leaveEpoch(thread_id); // <- exit before return
-			return true;
+	// Moves the item at oldKey to newKey with its value, instead of a
+	// remove and an add. Returns false, changing nothing, if oldKey is not
+	// there or newKey is (oldKey itself included). The new node, with the
+	// old one's tower height and a copy of its value, is built and its place
+	// found before the old node is marked, so the item is in neither place
+	// only between that mark and one link CAS. The searches share a path:
+	// newKey's starts from oldKey's preds and the cleanup of oldKey from
+	// newKey's, so keys d apart cost O(log d) for one of them either way.
+	// If newKey is added by someone else within that window, the item goes
+	// back under oldKey and the call returns false.
+	bool updateKey(const K& oldKey, const K& newKey) {
+		Guard guard;
+		SNodeBase* oldPreds[MaxLevel + 1] = {};
+		SNodeBase* oldSuccs[MaxLevel + 1] = {};
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
+
+		if (!find(oldKey, oldPreds, oldSuccs))
+			return false;
+		Node* node = static_cast<Node*>(oldSuccs[0]);
+		// the next find() reuses the slot that protects it; hazards hold the
+		// SNodeBase address, which is not the Node* one
+		guard.assign(HP_POP, oldSuccs[0]);
+		if (find(newKey, preds, succs, oldPreds, node->topLevel))
+			return false;
+		Node* newNode = Node::create(newKey, node->topLevel, *node->value());
+		if (!markNode(node)) {
+			delete newNode; // removed by another thread
+			return false;
+		}
+
+		bool moved = true;
+		while (!link(newNode, preds, succs)) {
+			// newKey was taken meanwhile: back under oldKey, or forth again
+			// while both keep being taken
+			do {
+				moved = !moved;
+				newNode->key = moved ? newKey : oldKey;
+			} while (find(newNode->key, preds, succs));
 		}
+		// unlinks node from every level; by its own key, as remove does
+		find(node->key, oldPreds, oldSuccs, preds, node->topLevel);
+		release(node);
+		wakeWaiters(); // a popMinWait may have found the list empty in between
+		return moved;
+	}
+
+	// Always goes through find(), which unlinks what it passes.
+	bool contains(const K& key, Finger& finger) {
+		Guard guard;
+		SNodeBase* succs[MaxLevel + 1];
+		bool found = find(key, finger.preds, succs, fingerHints(finger), 0);
+		stampFinger(finger);
+		return found;
 	}
 
-	bool contains(uint64_t key) {
-		EpochManager::instance().enterEpoch(thread_id);
+	bool contains(const K& key) {
+		Guard guard;
+		if constexpr (!Reclaimer::TRAVERSE_MARKED) {
+			// marked nodes cannot be stepped over, find() snips them
+			SNodeBase* preds[MaxLevel + 1];
+			SNodeBase* succs[MaxLevel + 1];
+			return find(key, preds, succs);
+		}
 		int bottomLevel = 0;
 		bool marked = false;
 		SNodeBase* pred = head;
 		SNodeBase* curr = nullptr;
 		SNodeBase* succ = nullptr;
 
-		for (int level = MAX_LEVEL - 1; level >= bottomLevel; --level) {
+		for (int level = currentLevel.load(std::memory_order_acquire); level >= bottomLevel; --level) {
 			curr = pred->next[level].getReference();
 			while (true) {
 				if (!curr) break; // prevent nullptr dereference
@@ -363,7 +635,8 @@ public:
 					succ = curr->next[level].get(marked);
 				}
 				if (!curr) break; // prevent nullptr dereference
-				if (curr->key < key) {
+				prefetchStep(succ, level);
+				if (before(curr, key)) {
 					pred = curr;
 					curr = succ;
 				}
@@ -372,22 +645,31 @@ public:
 				}
 			}
 		}
-		EpochManager::instance().leaveEpoch(thread_id);
-		return (curr->key == key);
+		return (matches(curr, key) && !curr->next[bottomLevel].getMark());
 	}
-	int randomLevel(int maxIndex = MAX_LEVEL, double p = 0.5) {
-		int level = 0; // use 0-based index
-		while ((std::rand() / double(RAND_MAX)) < p && level < maxIndex) ++level;
-		return level; // returns 0..maxIndex
+	// Tower height for a new node, 0..MaxLevel: every LogInvP trailing zero
+	// bits of one random word are a level, which is the geometric
+	// distribution without a loop over the generator.
+	static int randomLevel() {
+		int level = countTrailingZeros(threadRandom()) / LogInvP;
+		return level < MaxLevel ? level : MaxLevel;
 	}
-	T* get(uint64_t key) {
-		EpochManager::instance().enterEpoch(thread_id);
+	// Returns a copy of the value, taken while the node is still protected.
+	std::optional<T> get(const K& key) {
+		Guard guard;
+		if constexpr (!Reclaimer::TRAVERSE_MARKED) {
+			SNodeBase* preds[MaxLevel + 1];
+			SNodeBase* succs[MaxLevel + 1];
+			if (!find(key, preds, succs))
+				return std::nullopt;
+			return *static_cast<Node*>(succs[0])->value();
+		}
 		const int bottomLevel = 0;
 		SNodeBase* pred = head;
 		SNodeBase* curr = nullptr;
 		SNodeBase* succ = nullptr;
 
-		for (int level = MAX_LEVEL - 1; level >= bottomLevel; --level) {
+		for (int level = currentLevel.load(std::memory_order_acquire); level >= bottomLevel; --level) {
 			curr = pred->next[level].getReference();
 			while (curr != nullptr && curr != tail) {
 				bool marked = false;
@@ -401,8 +683,9 @@ public:
 				}
 
 				if (!curr || curr == tail) break;
+				prefetchStep(succ, level);
 
-				if (curr->key < key) {
+				if (before(curr, key)) {
 					pred = curr;
 					curr = succ;
 				}
@@ -417,19 +700,93 @@ public:
 		if (curr != nullptr)
 			curr->next[bottomLevel].get(nodeMarked);
 
-		if (curr && curr->key == key && !nodeMarked) {
-			EpochManager::instance().leaveEpoch(thread_id);
-			return static_cast<T*>(curr->data);
+		if (curr && matches(curr, key) && !nodeMarked)
+			return *static_cast<Node*>(curr)->value();
+		return std::nullopt;
+	}
+	// Looks up keys[0..n) and sets out[i] to a copy of keys[i]'s value or
+	// nullopt; returns how many were found. Under EpochManager it runs
+	// GET_MANY_LANES searches side by side, one step of each in turn, and each
+	// step prefetches the node its search reads next, so the cache misses of
+	// different keys overlap instead of queueing up (AMAC). That pays off on
+	// lists well beyond the cache; on a small hot one the loop over get() is
+	// quicker. Searches step over marked nodes as get() does. Each result is
+	// one get(), the batch is not a snapshot. Under hazard pointers every
+	// search would need its own slots, so it is a plain loop over get().
+	size_t getMany(const K* keys, size_t n, std::optional<T>* out) {
+		size_t found = 0;
+		if constexpr (!Reclaimer::TRAVERSE_MARKED) {
+			for (size_t i = 0; i < n; ++i)
+				found += (out[i] = get(keys[i])).has_value();
+			return found;
 		}
-		EpochManager::instance().leaveEpoch(thread_id);
-		return nullptr;
+		struct Lane {
+			size_t index;
+			int level;
+			SNodeBase* pred;
+			SNodeBase* curr;
+		};
+		for (size_t first = 0; first < n; first += GET_MANY_CHUNK) {
+			// one read section per chunk, so a long batch does not hold back
+			// reclamation for its whole run
+			Guard guard;
+			size_t last = std::min(n, first + GET_MANY_CHUNK);
+			size_t next = first;
+			int top = currentLevel.load(std::memory_order_acquire);
+			Lane lanes[GET_MANY_LANES];
+			int active = 0;
+			auto start = [&](Lane& lane) {
+				lane = Lane{ next++, top, head, head->next[top].getReference() };
+				prefetchStep(lane.curr, top);
+			};
+			while (active < GET_MANY_LANES && next < last)
+				start(lanes[active++]);
+			while (active > 0) {
+				for (int i = 0; i < active; ) {
+					Lane& lane = lanes[i];
+					const K& key = keys[lane.index];
+					bool marked = false;
+					SNodeBase* succ = lane.curr == tail ? nullptr : lane.curr->next[lane.level].get(marked);
+					if (marked) {
+						lane.curr = succ;
+					}
+					else if (before(lane.curr, key)) {
+						lane.pred = lane.curr;
+						lane.curr = succ;
+					}
+					else if (lane.level > 0) {
+						--lane.level;
+						lane.curr = lane.pred->next[lane.level].getReference();
+					}
+					else {
+						bool hit = matches(lane.curr, key) && !lane.curr->next[0].getMark();
+						if (hit)
+							out[lane.index] = *static_cast<Node*>(lane.curr)->value();
+						else
+							out[lane.index] = std::nullopt;
+						found += hit;
+						if (next < last) {
+							start(lane);
+							++i;
+						}
+						else {
+							lane = lanes[--active]; // not stepped yet this round
+						}
+						continue;
+					}
+					prefetchStep(lane.curr, lane.level);
+					++i;
+				}
+			}
+		}
+		return found;
 	}
-	SNode<T>* advancePred(SNode<T>* pred, int level) {
+	SNodeBase* advancePred(SNodeBase* pred, int level) {
 		bool marked;
-		SNode<T>* curr = reinterpret_cast<SNode<T>*>(pred->next[level].getReference());
+		SNodeBase* curr = pred->next[level].getReference();
 		while (curr && curr->next[level].get(marked) && marked) {
 			pred = curr;
-			curr = reinterpret_cast<SNode<T>*>(curr->next[level].getReference());
+			curr = curr->next[level].getReference();
 		}
 		return pred;
 	}
@@ -438,33 +795,717 @@ public:
 		SNodeBase* first = head->next[0].get(marked);
 		return first == tail;
 	}
-	T* popMin() {
-		EpochManager::instance().enterEpoch(thread_id);
-		constexpr int bottomLevel = 0;
+	// Key of the first node on the bottom level, nullopt when there is none.
+	// One protected read of head's successor: that node may be marked but
+	// not yet unlinked, so the key is at most the smallest live one. A hint
+	// under concurrent updates: the item may be gone by the time it is used.
+	std::optional<K> minKey() {
+		Guard guard;
+		bool marked = false;
+		SNodeBase* first = guard.protect(HP_MIN, head->next[0], marked);
+		if (first == tail)
+			return std::nullopt;
+		return keyOf(first);
+	}
+	// Number of items, from per-thread counters: O(1) in the list length
+	// and touching no shared line on add/remove, but approximate while
+	// others update it. Exact once the list is quiescent.
+	size_t size() const { return items.read(); }
+	// Totals of the Stats policy, shared by every list that uses it.
+	static StatsSnapshot stats() { return Stats::snapshot(); }
+	// Counts the bottom level with an iterator: O(n), exact with respect to
+	// the iterator's consistency (items that stay put are all counted).
+	size_t exactSize() {
+		size_t n = 0;
+		for (Iterator it(this); it.valid(); it.next())
+			++n;
+		return n;
+	}
+	// Not thread-safe: marked nodes still linked at any level. Every remove
+	// unlinks its node before it returns, so this is 0 whenever nothing runs.
+	size_t linkedMarked() {
+		Guard guard;
+		size_t n = 0;
+		for (int level = 0; level <= MaxLevel; ++level)
+			for (SNodeBase* node = head->next[level].getReference(); node != tail; node = node->next[level].getReference())
+				n += node->next[level].getMark();
+		return n;
+	}
+	// Switches popMin to a SprayList-style relaxed dequeue tuned for about
+	// expectedThreads concurrent consumers; 0 or 1 restores strict popMin.
+	// Instead of all fighting over head->next[0], each pop takes a random
+	// walk starting at level log2(p)+1 that jumps up to log2(p)+1 nodes per
+	// level, so consumers spread over the first few hundred items instead of
+	// one. Sprays favour tall nodes, so one pop in p is a strict one that
+	// drains whatever they left behind; that keeps the rank error (smaller
+	// keys still queued when one is returned) around O(p log p), see
+	// measureRankError in main.cpp. Set it before the list is shared.
+	void setRelaxedPopMin(int expectedThreads) {
+		if (expectedThreads <= 1) {
+			sprayThreads = 0;
+			sprayHeight = 0;
+			sprayJump = 0;
+			return;
+		}
+		int logP = 0;
+		while ((2 << logP) <= expectedThreads) ++logP;
+		sprayThreads = expectedThreads;
+		sprayHeight = logP + 1 < MaxLevel ? logP + 1 : MaxLevel;
+		sprayJump = logP + 1;
+	}
+	bool relaxedPopMin() const { return sprayJump != 0; }
+
+	// Removes the item with the smallest key and returns its value, or
+	// nullopt when the list is empty. In relaxed mode the item is one of the
+	// smallest instead.
+	std::optional<T> popMin() {
+		if (sprayJump && (threadRandom() >> 32) % uint32_t(sprayThreads) != 0) {
+			for (int attempt = 0; attempt < SPRAY_ATTEMPTS; ++attempt) {
+				bool drained = false;
+				std::optional<T> val = sprayPop(drained);
+				if (val || drained)
+					return val;
+			}
+		}
+		return popFirst();
+	}
+
+	// popMin that waits up to timeout for an item while the list is empty.
+	// It polls the list for a while (longer for threads whose polls tend to
+	// succeed), then parks on a futex / WaitOnAddress word that add signals,
+	// so idle consumers use no CPU and an add pays only a fence and a read
+	// unless a consumer is parked. Returns nullopt on timeout.
+	std::optional<T> popMinWait(std::chrono::nanoseconds timeout) {
+		using Clock = std::chrono::steady_clock;
+		static thread_local int spinBudget = POP_WAIT_SPIN_MIN;
+		if (std::optional<T> val = popMin())
+			return val;
+		Clock::time_point deadline = Clock::now() + timeout;
+		for (int spin = 0; spin < spinBudget; ++spin) {
+			cpuRelax();
+			if (empty())
+				continue;
+			if (std::optional<T> val = popMin()) {
+				spinBudget = std::min(spinBudget * 2, POP_WAIT_SPIN_MAX);
+				return val;
+			}
+		}
+		spinBudget = std::max(spinBudget / 2, POP_WAIT_SPIN_MIN);
+		while (true) {
+			// register before the last look, so an add that it misses sees us
+			waiting.sleepers.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			uint32_t seq = waiting.wakeSeq.load(std::memory_order_seq_cst);
+			std::optional<T> val = popMin();
+			Clock::time_point now = Clock::now();
+			if (!val && now < deadline)
+				waitOnWord(waiting.wakeSeq, seq, deadline - now);
+			waiting.sleepers.fetch_sub(1, std::memory_order_relaxed);
+			if (val)
+				return val;
+			if (Clock::now() >= deadline)
+				return popMin();
+		}
+	}
+
+	Iterator iterator() { return Iterator(this); }
+	// Starts at the first key not before from.
+	Iterator iterator(const K& from) { return Iterator(this, from); }
+
+	// Calls callback(key, value) for every item with lo <= key <= hi, in key
+	// order and with the iterator's consistency, and returns how many there
+	// were. One find() seeks to lo, then the scan follows next[0]. The
+	// callback runs inside the read section and may use the list, but not
+	// start another iterator or scan.
+	template <typename F>
+	size_t rangeScan(const K& lo, const K& hi, F&& callback) {
+		size_t visited = 0;
+		for (Iterator it(this, lo); it.valid() && !comp(hi, it.key()); it.next()) {
+			callback(it.key(), it.value());
+			++visited;
+		}
+		return visited;
+	}
+
+	// Pops up to n of the smallest items into out (appended in the order
+	// they were popped) and returns how many there were. Claims runs of
+	// consecutive bottom nodes inside one read section and unlinks each run
+	// with one CAS on head->next[0] and one find(); a run cut short by
+	// contention is followed by another, which may start below the last one
+	// if smaller keys were added meanwhile. Always strict, also in relaxed mode.
+	size_t popMinBatch(std::vector<T>& out, size_t n) {
+		Guard guard;
+		size_t popped = 0;
+		while (popped < n) {
+			size_t got = popRun(guard, out, std::min(n - popped, POP_BATCH_RUN));
+			if (got == 0)
+				break; // empty
+			popped += got;
+		}
+		return popped;
+	}
+
+	// Pops the items with keys not after bound, smallest first, up to n of
+	// them; appends them to out and returns how many. Each is one strict
+	// pop that checks the first key before it marks, so an item added
+	// meanwhile below bound is taken too. Drains expired deadlines, see
+	// TimerScheduler.
+	size_t popMinUntil(const K& bound, std::vector<T>& out, size_t n = SIZE_MAX) {
+		size_t popped = 0;
+		while (popped < n) {
+			std::optional<T> val = popFirst(&bound);
+			if (!val)
+				break;
+			out.push_back(std::move(*val));
+			++popped;
+		}
+		return popped;
+	}
+
+private:
+	// Publishes newNode, whose key find() did not see; preds/succs are from
+	// that find(). Returns false, with newNode still private, if the key
+	// shows up on a retry.
+	bool link(Node* newNode, SNodeBase* preds[MaxLevel + 1], SNodeBase* succs[MaxLevel + 1]) {
+		const int bottomLevel = 0;
+		while (true) {
+			// Step 1: Initialize next pointers of newNode to successors
+			for (int level = bottomLevel; level <= newNode->topLevel; ++level) {
+				newNode->next[level].set(succs[level], false);
+			}
+
+			// Step 2: Insert at bottom level first
+			if (preds[bottomLevel]->next[bottomLevel].compareAndSet(succs[bottomLevel], newNode, false, false))
+				break;
+			// CAS failed, retry from scratch
+			Stats::count(STAT_CAS_FAIL);
+			if (find(newNode->key, preds, succs))
+				return false;
+		}
+		linkUpper(newNode, bottomLevel + 1, preds, succs);
+		return true;
+	}
+
+	// Step 3 of an insert: links levels fromLevel..topLevel of a node that is
+	// already in the bottom level, then drops the inserter's reference.
+	void linkUpper(Node* newNode, int fromLevel, SNodeBase* preds[MaxLevel + 1], SNodeBase* succs[MaxLevel + 1]) {
+		const int bottomLevel = 0;
+		// The node is public now, so its links only change by CAS; a mark
+		// means it was already removed and there is no point in linking it
+		// any higher.
+		for (int level = fromLevel; level <= newNode->topLevel; ++level) {
+			while (true) {
+				SNodeBase* pred = preds[level];
+				SNodeBase* succ = succs[level];
+
+				bool marked = false;
+				SNodeBase* linked = newNode->next[level].get(marked);
+				if (marked)
+					goto LINKED;
+				if (linked != succ && !newNode->next[level].compareAndSet(linked, succ, false, false))
+					goto LINKED; // marked under us
+
+				if (pred->next[level].compareAndSet(succ, newNode, false, false))
+					break; // Success
+
+				// Retry find if CAS fails
+				Stats::count(STAT_CAS_FAIL);
+				find(newNode->key, preds, succs);
+			}
+		}
+	LINKED:
+		// A remover that ran its cleanup find() before one of our CASes
+		// left that level linked; unlink it again before letting go.
+		if (newNode->next[bottomLevel].getMark())
+			find(newNode->key, preds, succs);
+		release(newNode);
+	}
+
+	// Builds the towers for [first, last) privately, one pass, and publishes
+	// the bottom level with one CAS on the empty list. Stops at the first
+	// key out of order (duplicates are skipped), leaving first there.
+	// firstAt receives the first node of every level. Returns false if the
+	// list was not empty any more; nodes then holds the private nodes.
+	template <typename It>
+	bool buildRange(It& first, It last, std::vector<Node*>& nodes, SNodeBase* firstAt[MaxLevel + 1]) {
+		SNodeBase* lastAt[MaxLevel + 1];
+		for (int level = 0; level <= MaxLevel; ++level) {
+			firstAt[level] = nullptr;
+			lastAt[level] = nullptr;
+		}
+
+		for (; first != last; ++first) {
+			const K& key = first->first;
+			if (!nodes.empty() && !comp(nodes.back()->key, key)) {
+				if (!comp(key, nodes.back()->key))
+					continue; // duplicate
+				break;
+			}
+			Node* node = Node::create(key, randomLevel(), first->second);
+			for (int level = 0; level <= node->topLevel; ++level) {
+				if (lastAt[level])
+					lastAt[level]->next[level].set(node, false);
+				else
+					firstAt[level] = node;
+				lastAt[level] = node;
+			}
+			nodes.push_back(node);
+		}
+		int height = 0;
+		for (int level = 0; level <= MaxLevel && lastAt[level]; ++level) {
+			lastAt[level]->next[level].set(tail, false);
+			height = level;
+		}
+		raiseLevel(height);
+		return head->next[0].compareAndSet(tail, firstAt[0], false, false);
+	}
+
+	// Second half of a bulk build whose bottom level is published: hooks the
+	// upper levels onto head, bottom-up, while nobody else has linked a node
+	// there. From the first level someone has, the remaining levels of every
+	// node are linked one by one as add() does.
+	void linkRange(const std::vector<Node*>& nodes, SNodeBase* const firstAt[MaxLevel + 1], SNodeBase* preds[MaxLevel + 1], SNodeBase* succs[MaxLevel + 1]) {
+		int level = 1;
+		for (; level <= MaxLevel && firstAt[level]; ++level) {
+			if (!head->next[level].compareAndSet(tail, firstAt[level], false, false))
+				break;
+		}
+		for (Node* node : nodes) {
+			if (node->topLevel >= level)
+				find(node->key, preds, succs);
+			linkUpper(node, level, preds, succs);
+		}
+	}
+
+	// find()'s finger search; false if it has to start from head after all
+	// (no usable hint, or a pred was removed under it).
+	bool fingerSearch(Guard& guard, uint32_t (&hp)[3], const K& key, SNodeBase* preds[MaxLevel + 1],
+		SNodeBase* succs[MaxLevel + 1], SNodeBase* const* hints, int need, uint64_t& steps) {
+		int top = currentLevel.load(std::memory_order_acquire);
+		int from = -1;
+		for (int level = 0; level <= top && from < 0; ++level) {
+			SNodeBase* hint = hints[level];
+			if (!hint || (hint != head && !before(hint, key)))
+				continue;
+			// a node is marked at a level before it leaves it, so an unmarked
+			// hint is still linked where the earlier find() saw it
+			bool marked = false;
+			SNodeBase* succ = guard.protect(hp[2], hint->next[level], marked);
+			if (!marked && !before(succ, key))
+				from = level;
+		}
+		if (from < 0 || !descend(guard, hp, key, hints[from], from, preds, succs, hints, steps))
+			return false;
+		// Above from, a still-linked hint is at most a step or two from key:
+		// a level's nodes are on every level below, and none was between
+		// hints[from] and key.
+		for (int level = from + 1; level <= need; ++level) {
+			if (level > top) {
+				preds[level] = head;
+				succs[level] = tail;
+				continue;
+			}
+			SNodeBase* pred = hints[level];
+			if (!pred || (pred != head && !before(pred, key)) || !searchLevel(guard, hp, key, level, pred, preds, succs, steps))
+				return false;
+		}
+		return true;
+	}
+
+	// Searches levels from..0 from pred, which carries down; with hints, a
+	// level starts from its hint instead when that is further right, before
+	// key and still linked there. False if the search has to restart.
+	bool descend(Guard& guard, uint32_t (&hp)[3], const K& key, SNodeBase* pred, int from, SNodeBase* preds[MaxLevel + 1],
+		SNodeBase* succs[MaxLevel + 1], SNodeBase* const* hints, uint64_t& steps) {
+		for (int level = from; level >= 0; --level) {
+			if (hints) {
+				SNodeBase* hint = hints[level];
+				if (hint && hint != head && before(hint, key) && (pred == head || comp(keyOf(pred), keyOf(hint)))
+					&& !hint->next[level].getMark())
+					pred = hint; // protected by HP_PREDS + level since that find
+			}
+			if (!searchLevel(guard, hp, key, level, pred, preds, succs, steps))
+				return false;
+		}
+		return true;
+	}
+
+	// One level of a search: moves pred right to the last node before key,
+	// unlinking marked nodes it passes, and records pred and the node after
+	// it in preds/succs[level]. False if pred was marked or an unlink CAS
+	// failed, and the search has to restart.
+	bool searchLevel(Guard& guard, uint32_t (&hp)[3], const K& key, int level, SNodeBase*& pred,
+		SNodeBase* preds[MaxLevel + 1], SNodeBase* succs[MaxLevel + 1], uint64_t& steps) {
+		uint32_t& hpPred = hp[0];
+		uint32_t& hpCurr = hp[1];
+		uint32_t& hpSucc = hp[2];
+		bool marked = false;
+		SNodeBase* curr = guard.protect(hpCurr, pred->next[level], marked);
+		if (marked) {
+			Stats::count(STAT_FIND_RESTART);
+			return false; // pred is being removed under us
+		}
 		while (true) {
-			SNode<T>* curr = reinterpret_cast<SNode<T>*>(head->next[bottomLevel].getReference());
-			if (curr == tail || !curr) return nullptr;
+			SNodeBase* succ = guard.protect(hpSucc, curr->next[level], marked);
+
+			while (marked) {
+				// Try to physically remove curr
+				if (!pred->next[level].compareAndSet(curr, succ, false, false)) {
+					Stats::count(STAT_CAS_FAIL);
+					Stats::count(STAT_FIND_RESTART);
+					return false; // someone changed pred, restart whole search
+				}
+				Stats::count(STAT_UNLINK);
+
+				std::swap(hpCurr, hpSucc);
+				curr = succ;
+				succ = guard.protect(hpSucc, curr->next[level], marked);
+			}
+			prefetchStep(succ, level);
+
+			if (!before(curr, key))
+				break;
+			uint32_t spare = hpPred;
+			hpPred = hpCurr;
+			hpCurr = hpSucc;
+			hpSucc = spare;
+			pred = curr;
+			curr = succ; // advance curr AFTER pred is updated
+			++steps;
+		}
+		guard.assign(HP_PREDS + level, pred);
+		guard.assign(HP_SUCCS + level, curr);
+		preds[level] = pred;
+		succs[level] = curr;
+		return true;
+	}
+
+	// The finger's preds if they were read in the epoch the caller is
+	// pinned in right now, which keeps them allocated; else nullptr.
+	SNodeBase* const* fingerHints(const Finger& finger) const {
+		uint64_t epoch = Reclaimer::instance().pinnedEpoch(Reclaimer::threadId());
+		return finger.epoch == epoch && epoch != Reclaimer::EPOCH_QUIESCENT ? finger.preds : nullptr;
+	}
+	void stampFinger(Finger& finger) const {
+		finger.epoch = Reclaimer::instance().pinnedEpoch(Reclaimer::threadId());
+	}
+
+	void counted(int64_t delta) { items.add(Reclaimer::threadId(), delta); }
+	// After an item is linked: wakes parked popMinWait callers, if any. The
+	// fence orders the link before the sleepers read, against the
+	// consumer's register-then-look.
+	void wakeWaiters() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiting.sleepers.load(std::memory_order_relaxed) == 0)
+			return;
+		waiting.wakeSeq.fetch_add(1, std::memory_order_seq_cst);
+		wakeWord(waiting.wakeSeq);
+	}
+
+	void raiseLevel(int level) {
+		int top = currentLevel.load(std::memory_order_relaxed);
+		while (top < level && !currentLevel.compare_exchange_weak(top, level, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
 
+	// With a bound, fails instead when the first key is after it.
+	std::optional<T> popFirst(const K* bound = nullptr) {
+		Guard guard;
+		constexpr int bottomLevel = 0;
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
+		while (true) {
 			bool marked = false;
-			SNode<T>* succ = reinterpret_cast<SNode<T>*>(curr->next[bottomLevel].get(marked));
+			SNodeBase* curr = guard.protect(HP_POP, head->next[bottomLevel], marked);
+			if (curr == tail || !curr) return std::nullopt;
+
+			SNodeBase* succ = curr->next[bottomLevel].get(marked);
 			if (marked) {
+				Stats::count(STAT_POP_RETRY);
 				head->next[bottomLevel].compareAndSet(curr, succ, false, false);
 				continue;
 			}
+			if (bound && comp(*bound, keyOf(curr)))
+				return std::nullopt;
 
 			// Try to mark the node
-			if (curr->next[bottomLevel].compareAndSet(succ, succ, false, true)) {
-				// Marked successfully, help unlink
-				head->next[bottomLevel].compareAndSet(curr, succ, false, false);
-				T* val = static_cast<T*>(curr->data);
-				EpochManager::instance().retirePtr(static_cast<SNode<T>*>(curr), EpochManager::instance().currentEpoch());
-				EpochManager::instance().leaveEpoch(thread_id);
+			if (markNode(curr)) {
+				// Marked successfully, unlink it from every level
+				// copied rather than moved: a get() that found the node
+				// before our mark may still be reading the value
+				Node* node = static_cast<Node*>(curr);
+				std::optional<T> val(*node->value());
+				find(node->key, preds, succs);
+				release(node);
+				counted(-1);
 				return val;
 			}
 
 			// Another thread won, retry
+			Stats::count(STAT_POP_RETRY);
+		}
+	}
+
+	// Claims up to want nodes from the front, stopping early where the run
+	// is broken by a concurrent add or pop. Returns 0 only when empty.
+	size_t popRun(Guard& guard, std::vector<T>& out, size_t want) {
+		Node* run[POP_BATCH_RUN];
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
+		uint32_t hpCurr = HP_SPRAY, hpNext = HP_SPRAY + 1;
+		SNodeBase* curr = nullptr;
+		SNodeBase* next = nullptr;
+		bool marked = false;
+
+		// the first node is claimed like popFirst() does
+		while (true) {
+			curr = guard.protect(hpCurr, head->next[0], marked);
+			if (curr == tail)
+				return 0;
+			next = guard.protect(hpNext, curr->next[0], marked);
+			if (marked) {
+				head->next[0].compareAndSet(curr, next, false, false);
+				continue;
+			}
+			if (markNode(curr))
+				break;
+		}
+
+		// The rest follow while each successor is the one read before its
+		// predecessor was marked, which is what keeps it protected. Claimed
+		// nodes stay allocated through our reference until release().
+		size_t count = 0;
+		while (true) {
+			run[count++] = static_cast<Node*>(curr);
+			out.push_back(*run[count - 1]->value());
+			if (count == want || next == tail || curr->next[0].getReference() != next)
+				break;
+			std::swap(hpCurr, hpNext);
+			curr = next;
+			next = guard.protect(hpNext, curr->next[0], marked);
+			if (marked || !markNode(curr))
+				break;
+		}
+
+		// one CAS takes the whole run off the bottom level; find() on the
+		// last key snips the upper levels on its way down
+		const K& firstKey = run[0]->key; // run[0] is ours until released below
+		head->next[0].compareAndSet(run[0], run[count - 1]->next[0].getReference(), false, false);
+		find(run[count - 1]->key, preds, succs);
+		// A pred inside the run means an add landed between claimed nodes
+		// and find() started that level past some of them.
+		bool unlinked = true;
+		for (int level = 0; level <= MaxLevel; ++level) {
+			if (preds[level] != head && !comp(keyOf(preds[level]), firstKey))
+				unlinked = false;
+		}
+		if (!unlinked) {
+			for (size_t i = 0; i < count; ++i)
+				find(run[i]->key, preds, succs);
+		}
+		for (size_t i = 0; i < count; ++i)
+			release(run[i]);
+		counted(-int64_t(count));
+		return count;
+	}
+
+	// One spray: random walk down from sprayHeight, then claim the node it
+	// lands on or one of the next few. Returns nullopt with drained set when
+	// the list is empty, nullopt alone when every node it tried was taken.
+	std::optional<T> sprayPop(bool& drained) {
+		Guard guard;
+		SNodeBase* preds[MaxLevel + 1] = {};
+		SNodeBase* succs[MaxLevel + 1] = {};
+		uint32_t hpCurr = HP_SPRAY, hpNext = HP_SPRAY + 1;
+		SNodeBase* curr = head;
+		bool marked = false;
+
+		int top = currentLevel.load(std::memory_order_acquire);
+		for (int level = sprayHeight < top ? sprayHeight : top; level >= 0; --level) {
+			for (int jumps = int((threadRandom() >> 32) % uint32_t(sprayJump + 1)); jumps > 0; --jumps) {
+				SNodeBase* next = guard.protect(hpNext, curr->next[level], marked);
+				if ((marked && !Reclaimer::TRAVERSE_MARKED) || next == tail)
+					break; // can't step over a removed curr, or this level ends here
+				std::swap(hpCurr, hpNext);
+				curr = next;
+			}
+		}
+		if (curr == head) {
+			curr = guard.protect(hpCurr, head->next[0], marked);
+			if (curr == tail) {
+				drained = true;
+				return std::nullopt;
+			}
+		}
+
+		for (int tries = 0; tries <= sprayJump && curr != tail; ++tries) {
+			if (markNode(curr)) {
+				Node* node = static_cast<Node*>(curr);
+				std::optional<T> val(*node->value());
+				find(node->key, preds, succs);
+				release(node);
+				counted(-1);
+				return val;
+			}
+			// taken; without TRAVERSE_MARKED its successor may already be gone
+			if (!Reclaimer::TRAVERSE_MARKED)
+				break;
+			curr = guard.protect(hpNext, curr->next[0], marked);
+			std::swap(hpCurr, hpNext);
+		}
+		return std::nullopt;
+	}
+
+	// Logically deletes node: marks the upper levels top-down, then the
+	// bottom link. Only the thread whose bottom-level mark lands owns the removal.
+	bool markNode(SNodeBase* node) {
+		const int bottomLevel = 0;
+		for (int level = node->topLevel; level > bottomLevel; --level) {
+			bool marked = false;
+			SNodeBase* succ = node->next[level].get(marked);
+			while (!marked) {
+				node->next[level].attemptMark(succ, true);
+				succ = node->next[level].get(marked);
+			}
+		}
+		bool marked = false;
+		SNodeBase* succ = node->next[bottomLevel].get(marked);
+		while (!marked) {
+			if (node->next[bottomLevel].compareAndSet(succ, succ, false, true))
+				return true;
+			succ = node->next[bottomLevel].get(marked);
 		}
+		Stats::count(STAT_MARK_LOST);
+		return false;
+	}
+
+	void release(SNodeBase* node) {
+		// retired by its SNodeBase address, the one hazard pointers publish
+		if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Reclaimer::instance().retire(RETIRE_SNODE, typename Reclaimer::Retired{ node, &reclaimNode, Reclaimer::instance().currentEpoch() });
+	}
+	static void reclaimNode(void* p) { delete static_cast<Node*>(static_cast<SNodeBase*>(p)); }
+
+	static const K& keyOf(const SNodeBase* node) { return static_cast<const Node*>(node)->key; }
+	// Prefetches what a search step at level reads of node, its key and
+	// next[level], so the miss overlaps the compare before it. node may be
+	// tail or already freed: nothing is dereferenced, and the addresses are
+	// worked out as integers, as pointer arithmetic on a freed node is not
+	// allowed. The null past tail is skipped.
+	static void prefetchStep(const SNodeBase* node, int level) {
+		if (!node)
+			return;
+		uintptr_t at = reinterpret_cast<uintptr_t>(node);
+		prefetchRead(reinterpret_cast<const void*>(at - KEY_BACK));
+		prefetchRead(reinterpret_cast<const void*>(at + offsetof(SNodeBase, next) + level * sizeof(SNMarkablePointer)));
 	}
+	// node sorts before key; tail sorts after everything
+	bool before(const SNodeBase* node, const K& key) const { return node != tail && comp(keyOf(node), key); }
+	// node, not before key, holds key
+	bool matches(const SNodeBase* node, const K& key) const { return node != tail && !comp(key, keyOf(node)); }
 };
 
+// The original interface: uint64_t keys with the whole range usable.
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator,
+	int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+using SkipList = SkipListMap<uint64_t, T, std::less<uint64_t>, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
+
+// Key of a SkipListMultiMap node: the caller's key plus the insertion
+// sequence number that orders equal keys FIFO. Sequence numbers start at 1;
+// seq 0 is the lookup probe for "any node with this key".
+template <typename K>
+struct SeqKey {
+	K key;
+	uint64_t seq;
+};
+
+// Orders by key, then by seq. A probe (seq 0) is equivalent to every node
+// with its key, so a search for it stops at the oldest one: not a strict
+// weak order among probes, but it still splits the list into the nodes
+// before the key and the rest, which is all find() relies on.
+template <typename Compare>
+struct SeqKeyLess {
+	Compare comp;
+	template <typename K>
+	bool operator()(const SeqKey<K>& a, const SeqKey<K>& b) const {
+		if (comp(a.key, b.key))
+			return true;
+		if (comp(b.key, a.key))
+			return false;
+		return a.seq != 0 && b.seq != 0 && a.seq < b.seq;
+	}
+};
+
+// Priority queue with duplicate keys: add() always inserts, and items with
+// equal keys come out of popMin (and remove/get) oldest first. Built on a
+// SkipListMap keyed by (key, seq); the sequence number is one fetch_add on
+// a shared counter, which replaces the search-and-retry of salting colliding
+// keys by hand. Items added concurrently with equal keys are ordered by when
+// they drew their number, which can differ from when they became visible.
+template <typename K, typename T, typename Compare = std::less<K>, typename Reclaimer = EpochManager,
+	typename Alloc = HeapNodeAllocator, int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+class SkipListMultiMap {
+	using Map = SkipListMap<SeqKey<K>, T, SeqKeyLess<Compare>, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
+
+	Map map;
+	alignas(CACHE_LINE) std::atomic<uint64_t> nextSeq{ 1 };
+
+	static SeqKey<K> probe(const K& key) { return SeqKey<K>{ key, 0 }; }
+
+public:
+	explicit SkipListMultiMap(const Compare& comp = Compare()) : map(SeqKeyLess<Compare>{ comp }) {}
+
+	// Always inserts; returns true to match SkipListMap::add.
+	bool add(const K& key, T x) {
+		uint64_t seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+		return map.add(SeqKey<K>{ key, seq }, std::move(x));
+	}
+
+	// Removes the oldest item with key. A lost race for one copy moves on
+	// to the next, so this only fails once no copy is left.
+	bool remove(const K& key) {
+		while (true) {
+			if (map.remove(probe(key)))
+				return true;
+			if (!map.contains(probe(key)))
+				return false;
+		}
+	}
+
+	// Moves the oldest item with oldKey behind every item with newKey,
+	// keeping its value; see SkipListMap::updateKey. Its fresh sequence
+	// number means newKey is never taken, so like remove this only fails
+	// once no item with oldKey is left.
+	bool updateKey(const K& oldKey, const K& newKey) {
+		SeqKey<K> moved{ newKey, nextSeq.fetch_add(1, std::memory_order_relaxed) };
+		while (true) {
+			if (map.updateKey(probe(oldKey), moved))
+				return true;
+			if (!map.contains(probe(oldKey)))
+				return false;
+		}
+	}
+
+	bool contains(const K& key) { return map.contains(probe(key)); }
+	// Copy of the value of the oldest item with key.
+	std::optional<T> get(const K& key) { return map.get(probe(key)); }
+
+	// Every item with lo <= key <= hi, equal keys oldest first.
+	template <typename F>
+	size_t rangeScan(const K& lo, const K& hi, F&& callback) {
+		return map.rangeScan(probe(lo), probe(hi), [&](const SeqKey<K>& key, const T& value) { callback(key.key, value); });
+	}
+
+	std::optional<T> popMin() { return map.popMin(); }
+	std::optional<T> popMinWait(std::chrono::nanoseconds timeout) { return map.popMinWait(timeout); }
+	size_t popMinBatch(std::vector<T>& out, size_t n) { return map.popMinBatch(out, n); }
+	void setRelaxedPopMin(int expectedThreads) { map.setRelaxedPopMin(expectedThreads); }
+	bool empty() { return map.empty(); }
+	size_t size() const { return map.size(); }
+	size_t exactSize() { return map.exactSize(); }
+	size_t linkedMarked() { return map.linkedMarked(); }
+	static StatsSnapshot stats() { return Map::stats(); }
+};
 
+template <typename T, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator,
+	int MaxLevel = MAX_LEVEL, int LogInvP = 1, typename Stats = NoStats>
+using MultiSkipList = SkipListMultiMap<uint64_t, T, std::less<uint64_t>, Reclaimer, Alloc, MaxLevel, LogInvP, Stats>;
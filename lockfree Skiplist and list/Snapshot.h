@@ -0,0 +1,345 @@
+// Snapshots of a SkipListMap in a compact sorted file, and a restore that
+// maps the file and streams it into addRange's bulk build. For trivially
+// copyable keys and values only. The file keeps the machine's byte order
+// and type sizes, so it is for restarting the same build on the same kind
+// of machine, not for exchange.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOT_BLOCK_ITEMS = 4096; // items per block, and per iterator walk when saving
+
+// File layout: a SnapshotHeader, then blocks of up to SNAPSHOT_BLOCK_ITEMS
+// items in key order, each a SnapshotBlock followed by its payload: the
+// block's keys, then its values. Integral keys are stored as varint deltas
+// from the key before (the first from 0), so sorted keys close together
+// take a byte or two; other keys and all values are stored raw. Blocks
+// decode independently.
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t keyBytes;
+	uint32_t valueBytes;
+	uint32_t deltaKeys;
+	uint64_t items;
+};
+
+struct SnapshotBlock {
+	uint32_t items;
+	uint32_t bytes;    // payload after this header
+	uint64_t checksum; // FNV-1a of the payload
+};
+
+inline uint64_t snapshotChecksum(const unsigned char* p, size_t n) {
+	uint64_t h = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < n; ++i)
+		h = (h ^ p[i]) * 0x100000001B3ull;
+	return h;
+}
+
+// Encoding of one block, and the header expected for K and T.
+template <typename K, typename T>
+struct SnapshotFormat {
+	static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<T>::value,
+		"snapshots store keys and values as raw bytes");
+	static constexpr bool DELTA_KEYS = std::is_integral<K>::value && !std::is_same<K, bool>::value;
+	using Delta = typename std::conditional<DELTA_KEYS, std::make_unsigned<K>, std::common_type<uint64_t>>::type::type;
+
+	static SnapshotHeader header(uint64_t items) {
+		SnapshotHeader h{ { 'S', 'L', 'S', 'N', 'A', 'P', 0, 0 }, SNAPSHOT_VERSION, uint32_t(sizeof(K)), uint32_t(sizeof(T)),
+			DELTA_KEYS ? 1u : 0u, items };
+		return h;
+	}
+	static bool matches(const SnapshotHeader& h) {
+		SnapshotHeader expected = header(h.items);
+		return std::memcmp(&h, &expected, sizeof h) == 0;
+	}
+
+	static void encode(const std::vector<std::pair<K, T>>& items, std::vector<unsigned char>& out) {
+		out.clear();
+		Delta prev = 0;
+		for (const auto& item : items) {
+			if constexpr (DELTA_KEYS) {
+				Delta key = Delta(item.first);
+				uint64_t delta = uint64_t(Delta(key - prev));
+				prev = key;
+				while (delta >= 0x80) {
+					out.push_back(static_cast<unsigned char>(delta | 0x80));
+					delta >>= 7;
+				}
+				out.push_back(static_cast<unsigned char>(delta));
+			}
+			else {
+				append(out, &item.first, sizeof(K));
+			}
+		}
+		for (const auto& item : items)
+			append(out, &item.second, sizeof(T));
+	}
+
+	// Next key of a block from [p, end), false if the bytes run out.
+	static bool decodeKey(const unsigned char*& p, const unsigned char* end, Delta& prev, K& key) {
+		if constexpr (DELTA_KEYS) {
+			uint64_t delta = 0;
+			for (int shift = 0; ; shift += 7) {
+				if (p == end || shift > 63)
+					return false;
+				unsigned char byte = *p++;
+				delta |= uint64_t(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					break;
+			}
+			prev = Delta(prev + Delta(delta));
+			key = K(prev);
+		}
+		else {
+			if (size_t(end - p) < sizeof(K))
+				return false;
+			std::memcpy(&key, p, sizeof(K));
+			p += sizeof(K);
+		}
+		return true;
+	}
+
+private:
+	static void append(std::vector<unsigned char>& out, const void* p, size_t n) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(p);
+		out.insert(out.end(), bytes, bytes + n);
+	}
+};
+
+// Input iterator over the items of checked snapshot blocks, as addRange
+// wants it: (*it).first is the key, (*it).second the value. A
+// default-constructed cursor is the end.
+template <typename K, typename T>
+class SnapshotCursor {
+	using Format = SnapshotFormat<K, T>;
+
+public:
+	SnapshotCursor() = default;
+	SnapshotCursor(const unsigned char* blocks, const unsigned char* end) : pos(blocks), end(end) { advance(); }
+
+	const std::pair<K, T>& operator*() const { return item; }
+	const std::pair<K, T>* operator->() const { return &item; }
+	SnapshotCursor& operator++() {
+		advance();
+		return *this;
+	}
+	// only meaningful against the end
+	bool operator==(const SnapshotCursor& other) const { return done == other.done; }
+	bool operator!=(const SnapshotCursor& other) const { return done != other.done; }
+
+private:
+	const unsigned char* pos = nullptr; // next block header
+	const unsigned char* end = nullptr;
+	const unsigned char* keys = nullptr;   // next key of the current block
+	const unsigned char* values = nullptr; // next value of the current block
+	uint32_t left = 0;                     // items left in the current block
+	typename Format::Delta prevKey = 0;
+	std::pair<K, T> item{};
+	bool done = true;
+
+	void advance() {
+		while (left == 0) {
+			if (size_t(end - pos) < sizeof(SnapshotBlock)) {
+				done = true;
+				return;
+			}
+			SnapshotBlock block;
+			std::memcpy(&block, pos, sizeof block);
+			keys = pos + sizeof block;
+			pos = keys + block.bytes;
+			values = pos - size_t(block.items) * sizeof(T);
+			left = block.items;
+			prevKey = 0;
+		}
+		--left;
+		if (!Format::decodeKey(keys, values, prevKey, item.first)) {
+			done = true;
+			return;
+		}
+		std::memcpy(&item.second, values, sizeof(T));
+		values += sizeof(T);
+		done = false;
+	}
+};
+
+// Read-only view of a whole file: mapped on Windows and POSIX systems,
+// read into memory elsewhere. data() is nullptr if the file could not be
+// opened or is empty.
+class MappedFile {
+public:
+	explicit MappedFile(const char* path) {
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER bytes;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &bytes) || bytes.QuadPart == 0)
+			return;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			return;
+		view = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (view)
+			length = size_t(bytes.QuadPart);
+#elif defined(__unix__) || defined(__APPLE__)
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				madvise(p, size_t(st.st_size), MADV_SEQUENTIAL);
+				view = static_cast<const unsigned char*>(p);
+				length = size_t(st.st_size);
+			}
+		}
+		close(fd); // the mapping stays
+#else
+		std::ifstream in(path, std::ios::binary);
+		buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		if (!buffer.empty()) {
+			view = reinterpret_cast<const unsigned char*>(buffer.data());
+			length = buffer.size();
+		}
+#endif
+	}
+	~MappedFile() {
+#ifdef _WIN32
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#elif defined(__unix__) || defined(__APPLE__)
+		if (view)
+			munmap(const_cast<unsigned char*>(view), length);
+#endif
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const unsigned char* data() const { return view; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* view = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#elif !defined(__unix__) && !defined(__APPLE__)
+	std::vector<char> buffer;
+#endif
+};
+
+// Writes map's items to path and returns how many, or nullopt on an I/O
+// error. The walk has the iterator's consistency (items added or removed
+// meanwhile may or may not be in it) and is one iterator per block, so a
+// thread pinned for the save holds up reclamation for one block at a time,
+// not for the whole file. Map is a SkipListMap.
+template <typename Map>
+std::optional<size_t> saveSnapshot(Map& map, const char* path) {
+	using K = typename std::decay<decltype(map.iterator().key())>::type;
+	using T = typename std::decay<decltype(map.iterator().value())>::type;
+	using Format = SnapshotFormat<K, T>;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	SnapshotHeader header = Format::header(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof header);
+	std::vector<std::pair<K, T>> items;
+	std::vector<unsigned char> payload;
+	std::optional<K> from; // last key written
+	uint64_t total = 0;
+	auto collect = [&](auto&& it) {
+		// iterator(from) starts at from itself unless it went away meanwhile
+		if (from && it.valid() && std::memcmp(&it.key(), &*from, sizeof(K)) == 0)
+			it.next();
+		for (; it.valid() && items.size() < SNAPSHOT_BLOCK_ITEMS; it.next())
+			items.emplace_back(it.key(), it.value());
+	};
+	while (out) {
+		items.clear();
+		if (from)
+			collect(map.iterator(*from));
+		else
+			collect(map.iterator());
+		if (items.empty())
+			break;
+		from = items.back().first;
+		Format::encode(items, payload);
+		SnapshotBlock block{ uint32_t(items.size()), uint32_t(payload.size()), snapshotChecksum(payload.data(), payload.size()) };
+		out.write(reinterpret_cast<const char*>(&block), sizeof block);
+		out.write(reinterpret_cast<const char*>(payload.data()), std::streamsize(payload.size()));
+		total += items.size();
+	}
+	header.items = total;
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof header);
+	out.close();
+	if (!out)
+		return std::nullopt;
+	return size_t(total);
+}
+
+// Adds the items of a snapshot at path to map and returns how many were
+// new, or nullopt, with map unchanged, if the file is missing, was written
+// for other key or value types, or fails a block checksum: every block is
+// checked before the first item goes in. The items stream straight from
+// the mapping into addRange, so into an empty map the restore is one
+// sequential read and one bottom-up build; into a non-empty one they are
+// added one by one.
+template <typename Map>
+std::optional<size_t> loadSnapshot(Map& map, const char* path) {
+	using K = typename std::decay<decltype(map.iterator().key())>::type;
+	using T = typename std::decay<decltype(map.iterator().value())>::type;
+	using Format = SnapshotFormat<K, T>;
+
+	MappedFile file(path);
+	const unsigned char* p = file.data();
+	if (!p || file.size() < sizeof(SnapshotHeader))
+		return std::nullopt;
+	SnapshotHeader header;
+	std::memcpy(&header, p, sizeof header);
+	if (!Format::matches(header))
+		return std::nullopt;
+	const unsigned char* blocks = p + sizeof header;
+	const unsigned char* end = p + file.size();
+	uint64_t items = 0;
+	for (const unsigned char* q = blocks; q != end; ) {
+		SnapshotBlock block;
+		if (size_t(end - q) < sizeof block)
+			return std::nullopt;
+		std::memcpy(&block, q, sizeof block);
+		q += sizeof block;
+		size_t raw = size_t(block.items) * (sizeof(T) + (Format::DELTA_KEYS ? 1 : sizeof(K)));
+		if (block.items == 0 || block.bytes > size_t(end - q) || block.bytes < raw
+			|| snapshotChecksum(q, block.bytes) != block.checksum)
+			return std::nullopt;
+		q += block.bytes;
+		items += block.items;
+	}
+	if (items != header.items)
+		return std::nullopt;
+	return map.addRange(SnapshotCursor<K, T>(blocks, end), SnapshotCursor<K, T>());
+}
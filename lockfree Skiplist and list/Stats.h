@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include "Epochs.h"
+
+// Hot-path event counters for SkipList and List, chosen by their Stats
+// policy parameter. A policy provides
+//   static constexpr bool ENABLED;
+//   static void count(StatCounter c, uint64_t n = 1);
+//   static StatsSnapshot snapshot();
+// NoStats (the default) compiles every count away.
+enum StatCounter {
+	STAT_FIND,          // searches (find() calls)
+	STAT_FIND_RESTART,  // searches restarted from the start node
+	STAT_FIND_STEP,     // nodes searches moved past
+	STAT_UNLINK,        // marked nodes unlinked, own or helped
+	STAT_CAS_FAIL,      // failed linking or unlinking CASes
+	STAT_MARK_LOST,     // removals that lost the mark to another thread
+	STAT_POP_RETRY,     // popMin attempts that found the head taken
+	STAT_ELIMINATED,    // adds handed straight to a popMin (Elimination.h)
+	STAT_COUNT
+};
+
+inline const char* statName(StatCounter c) {
+	static const char* const names[STAT_COUNT] = {
+		"find", "find_restart", "find_step", "unlink", "cas_fail", "mark_lost", "pop_retry", "eliminated",
+	};
+	return names[c];
+}
+
+// Totals at one point in time. Subtract two snapshots for the counts of
+// the interval between them.
+struct StatsSnapshot {
+	uint64_t counts[STAT_COUNT] = {};
+
+	uint64_t operator[](StatCounter c) const { return counts[c]; }
+	StatsSnapshot operator-(const StatsSnapshot& earlier) const {
+		StatsSnapshot d;
+		for (int i = 0; i < STAT_COUNT; ++i)
+			d.counts[i] = counts[i] - earlier.counts[i];
+		return d;
+	}
+	friend std::ostream& operator<<(std::ostream& out, const StatsSnapshot& s) {
+		for (int i = 0; i < STAT_COUNT; ++i)
+			out << (i ? " " : "") << statName(StatCounter(i)) << "=" << s.counts[i];
+		return out;
+	}
+};
+
+struct NoStats {
+	static constexpr bool ENABLED = false;
+	static void count(StatCounter, uint64_t = 1) {}
+	static StatsSnapshot snapshot() { return StatsSnapshot{}; }
+};
+
+// Per-thread counters on cache lines of their own: a count is a relaxed
+// load and store by the owning thread, no RMW and no shared line. A
+// snapshot sums every thread's block, so it is not atomic across counters.
+// Blocks outlive their threads and are adopted by new ones, which keeps
+// the totals. Tag separates instances, e.g. ThreadStats<struct OrderBook>
+// for one list and the default for the rest.
+template <typename Tag = void>
+class ThreadStats {
+	struct alignas(CACHE_LINE) Block {
+		std::atomic<uint64_t> counts[STAT_COUNT] = {};
+	};
+	struct Registry {
+		std::mutex mutex;
+		std::vector<Block*> blocks;
+		std::vector<Block*> idle;
+	};
+	// never destroyed: thread_local exit hooks may run after static teardown
+	static Registry& registry() {
+		static Registry* inst = new Registry();
+		return *inst;
+	}
+	struct ThreadExit {
+		~ThreadExit() {
+			if (local) {
+				Registry& r = registry();
+				std::lock_guard<std::mutex> lock(r.mutex);
+				r.idle.push_back(local);
+				local = nullptr;
+			}
+			exited = true;
+		}
+	};
+	static inline thread_local Block* local = nullptr;
+	static inline thread_local bool exited = false;
+
+	// nullptr once the thread's exit hook ran
+	static Block* localBlock() {
+		if (!local && !exited) {
+			static thread_local ThreadExit exitHook;
+			(void)exitHook;
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			if (!r.idle.empty()) {
+				local = r.idle.back();
+				r.idle.pop_back();
+			}
+			else {
+				local = new Block();
+				r.blocks.push_back(local);
+			}
+		}
+		return local;
+	}
+
+public:
+	static constexpr bool ENABLED = true;
+
+	static void count(StatCounter c, uint64_t n = 1) {
+		Block* b = localBlock();
+		if (!b)
+			return;
+		std::atomic<uint64_t>& counter = b->counts[c];
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	static StatsSnapshot snapshot() {
+		StatsSnapshot s;
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (Block* b : r.blocks)
+			for (int i = 0; i < STAT_COUNT; ++i)
+				s.counts[i] += b->counts[i].load(std::memory_order_relaxed);
+		return s;
+	}
+};
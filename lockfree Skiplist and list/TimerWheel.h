@@ -0,0 +1,211 @@
+// Deadline scheduler: a two-level hierarchical timer wheel for near-term
+// timers in front of a SkipList for the far future. Level 0 has one slot
+// per tick for the current block of TIMER_L0_SLOTS ticks, level 1 one
+// slot per block for the next TIMER_L1_SLOTS blocks; only timers further
+// out than that go into the skiplist, which the dispatcher drains with
+// popMinUntil as their block comes into range. Wheel slots are push-only
+// stacks that the dispatcher empties with one exchange.
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "Skiplist.h"
+#include "HashMap.h"
+
+constexpr int TIMER_L0_BITS = 8;
+constexpr int TIMER_L1_BITS = 6;
+constexpr uint64_t TIMER_L0_SLOTS = uint64_t(1) << TIMER_L0_BITS; // ticks in a block
+constexpr uint64_t TIMER_L1_SLOTS = uint64_t(1) << TIMER_L1_BITS; // blocks ahead on level 1
+
+// Names a scheduled timer for cancel().
+struct TimerHandle {
+	uint64_t deadline = 0;
+	uint64_t id = 0; // 0 for none
+};
+
+// Ticks are the caller's unit (milliseconds, say); the scheduler never
+// reads a clock. schedule and cancel can be called from any thread, the
+// dispatcher (runExpired) from one at a time. A timer's task lives in a
+// LockFreeHashMap keyed by its id, and firing or cancelling it is the
+// removal of that entry, so each timer runs at most once however the two
+// race. Cancelled timers leave a small tombstone in the wheel, dropped when
+// its slot comes up, and are removed from the skiplist right away.
+//
+// A schedule that reads the time just before the dispatcher passes its
+// slot would otherwise sit a whole revolution in it: after publishing, it
+// re-reads the dispatcher's tick and, if its slot may already be done,
+// also hands the timer to a late stack that the dispatcher drains on every
+// call. Whichever copy comes first fires; the other finds the task gone.
+template <typename Task, typename Reclaimer = EpochManager, typename Alloc = HeapNodeAllocator>
+class TimerScheduler {
+	struct TimerNode {
+		uint64_t deadline;
+		uint64_t id;
+		TimerNode* next;
+	};
+	struct alignas(CACHE_LINE) Slot {
+		std::atomic<TimerNode*> head{ nullptr };
+	};
+	using Far = SkipListMap<SeqKey<uint64_t>, TimerHandle, SeqKeyLess<std::less<uint64_t>>, Reclaimer, Alloc>;
+
+	LockFreeHashMap<Task, Reclaimer, Alloc> tasks;
+	Far far;
+	Slot level0[TIMER_L0_SLOTS];
+	Slot level1[TIMER_L1_SLOTS];
+	Slot late;
+	alignas(CACHE_LINE) std::atomic<uint64_t> current; // last tick the dispatcher reached
+	std::atomic<bool> dispatching{ false };
+	alignas(CACHE_LINE) std::atomic<uint64_t> nextId{ 1 };
+
+public:
+	explicit TimerScheduler(uint64_t now = 0) : current(now) {}
+	// Not thread-safe. Pending timers are dropped without running.
+	~TimerScheduler() {
+		for (Slot& slot : level0)
+			freeAll(slot);
+		for (Slot& slot : level1)
+			freeAll(slot);
+		freeAll(late);
+	}
+	TimerScheduler(const TimerScheduler&) = delete;
+	TimerScheduler& operator=(const TimerScheduler&) = delete;
+
+	// Runs task on the first runExpired(now) with now >= deadline; a
+	// deadline already passed fires on the next call.
+	TimerHandle schedule(uint64_t deadline, Task task) {
+		TimerHandle h{ deadline, nextId.fetch_add(1, std::memory_order_relaxed) };
+		tasks.add(h.id, std::move(task));
+		uint64_t tick = current.load(std::memory_order_seq_cst);
+		if (deadline <= tick) {
+			push(late, h);
+			return h;
+		}
+		uint64_t done; // the dispatcher has emptied h's place once current reaches it
+		if (block(deadline) == block(tick)) {
+			push(level0[deadline & (TIMER_L0_SLOTS - 1)], h);
+			done = deadline;
+		}
+		else if (block(deadline) - block(tick) < TIMER_L1_SLOTS) {
+			push(level1[block(deadline) & (TIMER_L1_SLOTS - 1)], h);
+			done = block(deadline) << TIMER_L0_BITS;
+		}
+		else {
+			far.add(SeqKey<uint64_t>{ deadline, h.id }, h);
+			done = (block(deadline) - TIMER_L1_SLOTS + 1) << TIMER_L0_BITS;
+		}
+		if (current.load(std::memory_order_seq_cst) >= done)
+			push(late, h);
+		return h;
+	}
+
+	// True if the timer was pending and now never runs; false if it
+	// already ran, is running, or was cancelled before.
+	bool cancel(const TimerHandle& h) {
+		if (h.id == 0 || !tasks.remove(h.id))
+			return false;
+		far.remove(SeqKey<uint64_t>{ h.deadline, h.id });
+		return true;
+	}
+
+	// Advances to now and calls run(task) for every timer due by then, in
+	// tick order (ties and late schedules in no particular order). Returns
+	// how many ran, 0 if another thread is dispatching. The time taken is
+	// linear in the ticks passed, so call it at least every few blocks.
+	template <typename F>
+	size_t runExpired(uint64_t now, F&& run) {
+		if (dispatching.exchange(true, std::memory_order_acquire))
+			return 0;
+		size_t fired = 0;
+		uint64_t tick = current.load(std::memory_order_relaxed);
+		std::vector<TimerHandle> pulled;
+		while (tick < now) {
+			++tick;
+			current.store(tick, std::memory_order_seq_cst);
+			if ((tick & (TIMER_L0_SLOTS - 1)) == 0) {
+				// a new block: level 1's slot for it comes down, and the far
+				// timers of the block that just came into level 1's range
+				fired += fileAll(level1[block(tick) & (TIMER_L1_SLOTS - 1)], tick, run);
+				uint64_t horizon = (block(tick) + TIMER_L1_SLOTS) << TIMER_L0_BITS;
+				pulled.clear();
+				far.popMinUntil(SeqKey<uint64_t>{ horizon - 1, UINT64_MAX }, pulled);
+				for (const TimerHandle& h : pulled)
+					fired += file(new TimerNode{ h.deadline, h.id, nullptr }, tick, run);
+			}
+			fired += fileAll(level0[tick & (TIMER_L0_SLOTS - 1)], tick, run);
+		}
+		fired += fileAll(late, tick, run);
+		dispatching.store(false, std::memory_order_release);
+		return fired;
+	}
+
+	uint64_t now() const { return current.load(std::memory_order_relaxed); }
+	// Timers scheduled and not yet run or cancelled, approximate.
+	size_t pending() const { return tasks.size(); }
+	// Of those, the ones in the skiplist tier.
+	size_t farPending() const { return far.size(); }
+
+private:
+	static uint64_t block(uint64_t tick) { return tick >> TIMER_L0_BITS; }
+
+	static void push(Slot& slot, const TimerHandle& h) { pushNode(slot, new TimerNode{ h.deadline, h.id, nullptr }); }
+	static void pushNode(Slot& slot, TimerNode* node) {
+		TimerNode* old = slot.head.load(std::memory_order_relaxed);
+		do {
+			node->next = old;
+		} while (!slot.head.compare_exchange_weak(old, node, std::memory_order_seq_cst, std::memory_order_relaxed));
+	}
+	static void freeAll(Slot& slot) {
+		TimerNode* node = slot.head.exchange(nullptr, std::memory_order_acquire);
+		while (node) {
+			TimerNode* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+	template <typename F>
+	size_t fileAll(Slot& slot, uint64_t tick, F& run) {
+		if (!slot.head.load(std::memory_order_relaxed))
+			return 0;
+		size_t fired = 0;
+		TimerNode* node = slot.head.exchange(nullptr, std::memory_order_seq_cst);
+		while (node) {
+			TimerNode* next = node->next;
+			fired += file(node, tick, run);
+			node = next;
+		}
+		return fired;
+	}
+
+	// Dispatcher side: runs node's timer if it is due at tick, otherwise
+	// moves it to the slot it belongs in now; nothing else drains those
+	// slots meanwhile, so no late check.
+	template <typename F>
+	size_t file(TimerNode* node, uint64_t tick, F& run) {
+		if (node->deadline <= tick) {
+			size_t fired = 0;
+			std::optional<Task> task = tasks.get(node->id);
+			if (task && tasks.remove(node->id)) {
+				run(*task);
+				fired = 1;
+			}
+			delete node;
+			return fired;
+		}
+		if (!tasks.contains(node->id)) {
+			delete node; // cancelled, or the other copy of a late schedule fired
+			return 0;
+		}
+		if (block(node->deadline) == block(tick))
+			pushNode(level0[node->deadline & (TIMER_L0_SLOTS - 1)], node);
+		else if (block(node->deadline) - block(tick) < TIMER_L1_SLOTS)
+			pushNode(level1[block(node->deadline) & (TIMER_L1_SLOTS - 1)], node);
+		else {
+			far.add(SeqKey<uint64_t>{ node->deadline, node->id }, TimerHandle{ node->deadline, node->id });
+			delete node;
+		}
+		return 0;
+	}
+};
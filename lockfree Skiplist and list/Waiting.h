@@ -0,0 +1,60 @@
+// Spinning and parking on a 32-bit word for popMinWait and the
+// elimination slots: futex on Linux, WaitOnAddress on Windows, a short
+// sleep anywhere else. Waits can return early and spuriously; callers
+// re-check their condition.
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+inline void cpuRelax() {
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	_mm_pause();
+#endif
+}
+
+// Blocks while word == expected, for at most timeout.
+inline void waitOnWord(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+	if (timeout.count() <= 0)
+		return;
+#ifdef _WIN32
+	long long ms = (timeout.count() + 999999) / 1000000;
+	WaitOnAddress(&word, &expected, sizeof(expected), DWORD(ms < 0x7FFFFFFF ? ms : 0x7FFFFFFF));
+#elif defined(__linux__)
+	timespec ts;
+	ts.tv_sec = time_t(timeout.count() / 1000000000);
+	ts.tv_nsec = long(timeout.count() % 1000000000);
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+	if (word.load(std::memory_order_acquire) == expected)
+		std::this_thread::sleep_for(timeout < std::chrono::milliseconds(1) ? timeout : std::chrono::milliseconds(1));
+#endif
+}
+
+// Wakes every thread blocked in waitOnWord on word.
+inline void wakeWord(std::atomic<uint32_t>& word) {
+#ifdef _WIN32
+	WakeByAddressAll(&word);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word;
+#endif
+}
@@ -1,12 +1,25 @@
 #include "List.h"
 #include "Skiplist.h"
+#include "HashMap.h"
+#include "MultiQueue.h"
+#include "Elimination.h"
+#include "TimerWheel.h"
+#include "Snapshot.h"
+#include "Lincheck.h"
+#include "Benchmark.h"
 #include <iostream>
 #include <thread>
 #include <vector>
 #include <atomic>
 #include <mutex>
 #include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <fstream>
 #include "Epochs.h"
+#include "HazardPointers.h"
+#include "NodeAllocator.h"
 // simple helper to assign thread_id manually
 constexpr int THREAD_COUNT = 4;
 constexpr int OPS_PER_THREAD = 2000;
@@ -26,7 +39,7 @@ void register_thread(int id) {
 void popWorker(int threadId, SkipList<int>& list, std::vector<int>& results, std::mutex& resultsMutex) {
     register_thread(threadId);
     while (true) {
-        int* val = list.popMin();
+        std::optional<int> val = list.popMin();
         if (!val) break; // skiplist empty
 
         {
@@ -64,7 +77,979 @@ void worker2(int threadId, int start, int end) {
     }
 }
 
-int main() {
+// Times the workloads above (disjoint-key churn, then a popMin drain) on
+// the given SkipList configuration, without the printing of the smoke tests.
+// sprayThreads > 0 drains with the relaxed popMin.
+template <typename Queue>
+void benchmarkQueue(const char* name, int threadCount, int opsPerThread, int sprayThreads = 0) {
+    using Clock = std::chrono::steady_clock;
+
+    Queue churn;
+    auto start = Clock::now();
+    std::vector<std::thread> churnThreads;
+    for (int t = 0; t < threadCount; ++t) {
+        churnThreads.emplace_back([&, t]() {
+            for (int i = t * opsPerThread; i < (t + 1) * opsPerThread; ++i) {
+                churn.add(i, i);
+                churn.get(i);
+                churn.contains(i);
+                churn.remove(i);
+            }
+        });
+    }
+    for (auto& th : churnThreads) th.join();
+    double churnMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    Queue drain;
+    drain.setRelaxedPopMin(sprayThreads);
+    for (int i = 0; i < threadCount * opsPerThread; ++i)
+        drain.add(i, i);
+    start = Clock::now();
+    std::vector<std::thread> drainThreads;
+    for (int t = 0; t < threadCount; ++t) {
+        drainThreads.emplace_back([&]() {
+            while (drain.popMin()) {}
+        });
+    }
+    for (auto& th : drainThreads) th.join();
+    double drainMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    Queue batchDrain;
+    for (int i = 0; i < threadCount * opsPerThread; ++i)
+        batchDrain.add(i, i);
+    start = Clock::now();
+    std::vector<std::thread> batchThreads;
+    for (int t = 0; t < threadCount; ++t) {
+        batchThreads.emplace_back([&]() {
+            std::vector<int> batch;
+            batch.reserve(64);
+            while (batchDrain.popMinBatch(batch, 64))
+                batch.clear();
+        });
+    }
+    for (auto& th : batchThreads) th.join();
+    double batchMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << name << ": churn " << churnMs << " ms, popMin drain " << drainMs << " ms, popMinBatch(64) drain " << batchMs << " ms ("
+        << threadCount << " threads, " << opsPerThread << " keys each)\n";
+}
+
+// Warm start: loads sorted keys with add() one by one, with addRange()
+// into an empty list, and with addRange() merging the odd keys into a
+// list that already holds the even ones.
+template <typename Queue>
+void benchmarkBulkLoad(const char* name, int keys) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::pair<uint64_t, int>> sorted;
+    sorted.reserve(keys);
+    for (int i = 0; i < keys; ++i)
+        sorted.emplace_back(uint64_t(i) + 1, i);
+
+    auto start = Clock::now();
+    {
+        Queue q;
+        for (auto& kv : sorted)
+            q.add(kv.first, kv.second);
+    }
+    double addMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    size_t built;
+    {
+        Queue q;
+        built = q.addRange(sorted.begin(), sorted.end());
+    }
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::vector<std::pair<uint64_t, int>> evens, odds;
+    for (auto& kv : sorted)
+        (kv.first % 2 ? odds : evens).push_back(kv);
+    size_t merged;
+    Queue q;
+    q.addRange(evens.begin(), evens.end());
+    start = Clock::now();
+    merged = q.addRange(odds.begin(), odds.end());
+    double mergeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::cout << name << ": " << keys << " sorted keys, add() " << addMs << " ms, addRange() " << buildMs
+        << " ms (" << built << " new), merging half " << mergeMs << " ms (" << merged << " new)\n";
+}
+
+// Saves a list while a writer churns keys above the stable ones, restores
+// it into an empty list and compares; a damaged file or one written for
+// another value type must be refused without touching the list. Prints
+// the times next to re-adding the items one by one.
+template <typename Queue>
+void testSnapshot(const char* name, int keys) {
+    using Clock = std::chrono::steady_clock;
+    const char* path = "skiplist.snapshot";
+    const uint64_t churnBase = uint64_t(keys) * 3 + 1;
+    int bad = 0;
+    Queue q;
+    std::vector<std::pair<uint64_t, int>> stable;
+    for (int i = 0; i < keys; ++i)
+        stable.emplace_back(uint64_t(i) * 3 + 1, i);
+    q.addRange(stable.begin(), stable.end());
+
+    std::atomic<bool> saving{ true };
+    std::thread writer([&]() {
+        for (uint64_t i = 0; saving.load(); ++i) {
+            q.add(churnBase + i % 1024, int(i));
+            q.remove(churnBase + (i + 512) % 1024);
+        }
+    });
+    auto start = Clock::now();
+    std::optional<size_t> saved = saveSnapshot(q, path);
+    double saveMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    saving.store(false);
+    writer.join();
+    if (!saved || *saved < size_t(keys)) bad++;
+
+    Queue restored;
+    start = Clock::now();
+    std::optional<size_t> loaded = loadSnapshot(restored, path);
+    double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (!loaded || loaded != saved) bad++;
+    for (auto& kv : stable) {
+        std::optional<int> val = restored.get(kv.first);
+        if (!val || *val != kv.second) bad++;
+    }
+    size_t previous = 0;
+    for (auto it = restored.iterator(); it.valid(); it.next()) {
+        if (previous >= it.key() || (it.key() >= churnBase + 1024) || (it.key() < churnBase && it.key() % 3 != 1)) bad++;
+        previous = size_t(it.key());
+    }
+
+    start = Clock::now();
+    {
+        Queue slow;
+        for (auto& kv : stable)
+            slow.add(kv.first, kv.second);
+    }
+    double addMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(0, std::ios::end);
+    std::streamoff bytes = file.tellg();
+    std::streamoff victim = std::streamoff(sizeof(SnapshotHeader) + sizeof(SnapshotBlock) + 100);
+    file.seekg(victim);
+    char byte = char(file.get());
+    file.seekp(victim);
+    file.put(char(~byte));
+    file.close();
+    Queue damaged;
+    if (loadSnapshot(damaged, path) || !damaged.empty()) bad++;
+    SkipList<double> otherType;
+    if (loadSnapshot(otherType, path) || !otherType.empty()) bad++;
+    std::remove(path);
+
+    std::cout << "Snapshot test [" << name << "] " << keys << " items in " << bytes << " bytes, saved in " << saveMs << " ms, restored in "
+        << loadMs << " ms (add() " << addMs << " ms), failures: " << bad << "\n";
+}
+
+// getMany against get() on the same probes while a writer churns keys in
+// between: stable keys must be found with their value, missing ones not,
+// churned ones either way.
+template <typename Queue>
+void testGetMany(const char* name, int keys, int probes) {
+    using Clock = std::chrono::steady_clock;
+    int bad = 0;
+    Queue q;
+    std::vector<std::pair<uint64_t, int>> stable;
+    for (int i = 0; i < keys; ++i)
+        stable.emplace_back(uint64_t(i) * 4 + 1, i);
+    q.addRange(stable.begin(), stable.end());
+    std::vector<uint64_t> probe(probes);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (auto& k : probe) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        k = x % (uint64_t(keys) * 4); // 4i+1 stable, 4i+3 churned, others missing
+    }
+
+    std::atomic<bool> running{ true };
+    std::thread writer([&]() {
+        for (uint64_t i = 0; running.load(); ++i) {
+            uint64_t k = (i * 7919 % keys) * 4 + 3;
+            if (!q.add(k, -1))
+                q.remove(k);
+        }
+    });
+    std::vector<std::optional<int>> out(probes);
+    auto start = Clock::now();
+    size_t found = q.getMany(probe.data(), probe.size(), out.data());
+    double manyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    size_t foundOne = 0;
+    for (uint64_t k : probe)
+        foundOne += q.get(k).has_value();
+    double getMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    running.store(false);
+    writer.join();
+
+    size_t counted = 0;
+    for (int i = 0; i < probes; ++i) {
+        counted += out[i].has_value();
+        switch (probe[i] % 4) {
+        case 1: if (!out[i] || *out[i] != int(probe[i] / 4)) bad++; break;
+        case 3: if (out[i] && *out[i] != -1) bad++; break;
+        default: if (out[i]) bad++; break;
+        }
+    }
+    if (counted != found || foundOne == 0) bad++;
+    std::cout << "getMany test [" << name << "] " << probes << " lookups in " << keys << " keys, getMany " << manyMs
+        << " ms, get() " << getMs << " ms, failures: " << bad << "\n";
+}
+
+// Fingers under churn: each thread walks its own keys (interleaved with
+// the others') upwards with one Finger, adding each key, then removing the
+// one two keys back, so its hints are other threads' nodes, often just
+// removed; then back down, where the hints are behind no key. A second
+// finger, used every 1024 keys, holds hints from epochs long gone, which
+// must not be followed. Every result is known in advance, and the list
+// must end with no marked node linked.
+template <typename Queue>
+void testFinger(const char* name, int threadCount, int keysPerThread) {
+    Queue q;
+    std::atomic<int> bad{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            typename Queue::Finger finger, stale;
+            auto key = [&](int i) { return uint64_t(i) * threadCount + t; };
+            for (int i = 0; i < keysPerThread; ++i) {
+                if (!q.add(key(i), i, finger) || q.add(key(i), i, finger)) bad++;
+                if (!q.contains(key(i), finger)) bad++;
+                if (i % 1024 == 0 && !q.contains(key(i), stale)) bad++;
+                if (i >= 2) {
+                    if (!q.remove(key(i - 2), finger) || q.remove(key(i - 2), finger)) bad++;
+                    if (q.contains(key(i - 2), finger)) bad++;
+                }
+            }
+            for (int i = keysPerThread - 1; i >= 0; --i) {
+                if (q.contains(key(i), finger) != (i >= keysPerThread - 2)) bad++;
+                if (i % 2 && q.add(key(i), i, finger) == (i >= keysPerThread - 2)) bad++;
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    // per thread: its last two keys, plus the odd ones below them added back
+    size_t expected = 0;
+    for (int i = 0; i < keysPerThread; ++i)
+        expected += i >= keysPerThread - 2 || i % 2;
+    expected *= size_t(threadCount);
+    if (q.linkedMarked() != 0) bad++;
+    if (q.exactSize() != expected || q.size() != expected) bad++;
+    std::cout << "Finger test [" << name << "] " << threadCount << " threads, " << keysPerThread << " keys each, failures: " << bad << "\n";
+}
+
+// Producers with per-thread increasing keys (interleaved ranges), with and
+// without a Finger carried from one add() to the next.
+template <typename Queue>
+void benchmarkFinger(const char* name, int threadCount, int keysPerThread) {
+    using Clock = std::chrono::steady_clock;
+    double ms[2];
+    for (int useFinger = 0; useFinger < 2; ++useFinger) {
+        Queue q;
+        for (int i = 0; i < threadCount * keysPerThread; i += 2)
+            q.add(uint64_t(i) * threadCount + 1, i); // keys to search past
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                typename Queue::Finger finger;
+                uint64_t base = uint64_t(t) * keysPerThread * threadCount * 2;
+                for (int i = 0; i < keysPerThread; ++i) {
+                    uint64_t key = base + uint64_t(i) * 2 + 2;
+                    if (useFinger)
+                        q.add(key, i, finger);
+                    else
+                        q.add(key, i);
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+        ms[useFinger] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    std::cout << name << ": in-order producers, add() " << ms[0] << " ms, add() with finger " << ms[1] << " ms ("
+        << threadCount << " threads, " << keysPerThread << " keys each)\n";
+}
+
+// Rank error of the relaxed popMin: how many smaller keys were still in the
+// queue when each key was popped (0 for strict popMin). Single threaded, so
+// it measures the spray itself.
+template <typename Queue>
+void measureRankError(const char* name, int sprayThreads, int total) {
+    Queue q;
+    q.setRelaxedPopMin(sprayThreads);
+    for (int i = 0; i < total; ++i)
+        q.add(i, i);
+
+    std::vector<bool> popped(total, false);
+    int lowest = 0; // smallest key not popped yet
+    long long rankSum = 0;
+    int rankMax = 0;
+    while (std::optional<int> val = q.popMin()) {
+        int rank = 0;
+        for (int k = lowest; k < *val; ++k)
+            if (!popped[k]) ++rank;
+        popped[*val] = true;
+        while (lowest < total && popped[lowest]) ++lowest;
+        rankSum += rank;
+        rankMax = std::max(rankMax, rank);
+    }
+    std::cout << name << ": relaxed popMin for " << sprayThreads << " threads, rank error mean "
+        << double(rankSum) / total << ", max " << rankMax << " (" << total << " keys)\n";
+}
+
+// Scans under churn: even keys stay put while writers add and remove odd
+// ones, so every scan must see all even keys in its range, in order.
+template <typename Queue>
+void testRangeScan(const char* name, int writerCount, int keys) {
+    Queue q;
+    for (int k = 0; k < keys; k += 2)
+        q.add(k, k);
+    std::atomic<bool> done{ false };
+    std::atomic<int> bad{ 0 };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < writerCount; ++t) {
+        writers.emplace_back([&, t]() {
+            uint64_t x = t + 1;
+            while (!done.load()) {
+                x = x * 6364136223846793005ull + 1442695040888963407ull;
+                int k = int((x >> 33) % uint64_t(keys)) | 1;
+                if (x & (1ull << 62)) q.add(k, k);
+                else q.remove(k);
+            }
+        });
+    }
+    for (int round = 0; round < 200; ++round) {
+        uint64_t lo = uint64_t(round * 7) % uint64_t(keys / 2), hi = lo + keys / 2;
+        int64_t prev = -1;
+        uint64_t evens = 0;
+        q.rangeScan(lo, hi, [&](uint64_t key, int value) {
+            if (int64_t(key) <= prev || key < lo || key > hi || value != int(key)) bad++;
+            if (key % 2 == 0) evens++;
+            prev = int64_t(key);
+        });
+        if (evens != hi / 2 - (lo + 1) / 2 + 1) bad++;
+    }
+    size_t all = 0;
+    for (auto it = q.iterator(); it.valid(); it.next())
+        all += it.key() % 2 == 0;
+    if (all != size_t(keys / 2)) bad++;
+    done = true;
+    for (auto& th : writers) th.join();
+    std::cout << name << ": range scan test complete, failures: " << bad << "\n";
+}
+
+// Scans whose callback uses other lists while writers churn the odd keys
+// of the scanned one: minKey() on a second list, and add and popMin on an
+// EliminationSkipList, which read first keys too. Under hazard pointers
+// the slots are the thread's, so none of these may take the scan's.
+template <typename Queue, typename Side>
+void testScanCallbacks(const char* name, int writerCount, int keys) {
+    Queue q, other;
+    Side side;
+    for (int k = 0; k < keys; k += 2) {
+        q.add(k, k);
+        other.add(k, k);
+    }
+    std::atomic<bool> done{ false };
+    std::atomic<int> bad{ 0 };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < writerCount; ++t) {
+        writers.emplace_back([&, t]() {
+            uint64_t x = t + 1;
+            while (!done.load()) {
+                x = x * 6364136223846793005ull + 1442695040888963407ull;
+                int k = int((x >> 33) % uint64_t(keys)) | 1;
+                Queue& target = x & (1ull << 61) ? q : other;
+                if (x & (1ull << 62)) target.add(k, k);
+                else target.remove(k);
+            }
+        });
+    }
+    for (int round = 0; round < 100; ++round) {
+        int64_t prev = -1;
+        uint64_t evens = 0;
+        q.rangeScan(0, uint64_t(keys), [&](uint64_t key, int value) {
+            if (int64_t(key) <= prev || value != int(key)) bad++;
+            if (key % 2 == 0) evens++;
+            prev = int64_t(key);
+            if (other.minKey() != std::optional<uint64_t>(0)) bad++; // key 0 stays put
+            side.add(key, value);
+            if (side.popMin() != std::optional<int>(value)) bad++;
+        });
+        if (evens != uint64_t(keys / 2)) bad++;
+    }
+    done = true;
+    for (auto& th : writers) th.join();
+    if (!side.empty()) bad++;
+    std::cout << name << ": scan callback test complete, failures: " << bad << "\n";
+}
+
+// Expiry sweep: every key up to a cutoff, probed with contains() one by one
+// or read with one rangeScan().
+template <typename Queue>
+void benchmarkScan(const char* name, int keys) {
+    using Clock = std::chrono::steady_clock;
+    Queue q;
+    for (int k = 0; k < keys; ++k)
+        q.add(uint64_t(k) * 3, k);
+    uint64_t cutoff = uint64_t(keys) * 3 / 2;
+
+    auto start = Clock::now();
+    size_t probed = 0;
+    for (uint64_t k = 0; k <= cutoff; ++k)
+        probed += q.contains(k);
+    double probeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    start = Clock::now();
+    size_t scanned = q.rangeScan(0, cutoff, [](uint64_t, int) {});
+    double scanMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << name << ": sweep of " << scanned << " keys (" << probed << " probed), contains() " << probeMs
+        << " ms, rangeScan() " << scanMs << " ms\n";
+}
+
+// Threads add, remove and look up overlapping keys while the table grows;
+// afterwards every key must be where the per-key add/remove tally says.
+template <typename Map>
+void testHashMap(const char* name, int threadCount, int keys) {
+    Map map;
+    std::vector<std::atomic<int>> net(keys);
+    std::atomic<int> bad{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = t + 1;
+            for (int i = 0; i < 200000; ++i) {
+                x = x * 6364136223846793005ull + 1442695040888963407ull;
+                int k = int((x >> 33) % uint64_t(keys));
+                switch ((x >> 60) & 3) {
+                case 0: case 1: if (map.add(k, k)) net[k]++; break;
+                case 2: if (map.remove(k)) net[k]--; break;
+                default: { std::optional<int> v = map.get(k); if (v && *v != k) bad++; }
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    size_t present = 0;
+    for (int k = 0; k < keys; ++k) {
+        if (net[k] != int(map.contains(k))) bad++;
+        present += map.contains(k);
+    }
+    if (map.size() != present) bad++;
+    std::cout << name << ": hash map test complete, " << present << " keys in " << map.buckets()
+        << " buckets, failures: " << bad << "\n";
+}
+
+// Point lookups of present keys, hash map against skiplist.
+template <typename Map, typename Queue>
+void benchmarkLookup(const char* name, int threadCount, int keys) {
+    using Clock = std::chrono::steady_clock;
+    Map map;
+    Queue q;
+    for (int k = 0; k < keys; ++k) {
+        map.add(uint64_t(k) * 7, k);
+        q.add(uint64_t(k) * 7, k);
+    }
+    double ms[2];
+    for (int useMap = 0; useMap < 2; ++useMap) {
+        std::atomic<long long> found{ 0 };
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                long long hits = 0;
+                uint64_t x = t + 1;
+                for (int i = 0; i < keys; ++i) {
+                    x = x * 6364136223846793005ull + 1442695040888963407ull;
+                    uint64_t key = (x >> 33) % uint64_t(keys) * 7;
+                    hits += useMap ? map.get(key).has_value() : q.get(key).has_value();
+                }
+                found += hits;
+            });
+        }
+        for (auto& th : threads) th.join();
+        ms[useMap] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (found != (long long)threadCount * keys) std::cout << "lookup missed keys\n";
+    }
+    std::cout << name << ": point lookups, SkipList get() " << ms[0] << " ms, LockFreeHashMap get() " << ms[1]
+        << " ms (" << threadCount << " threads, " << keys << " keys)\n";
+}
+
+// Composite priority: earliest deadline first, then submission order.
+struct Deadline {
+    uint64_t deadline;
+    uint64_t seq;
+};
+struct DeadlineLess {
+    bool operator()(const Deadline& a, const Deadline& b) const {
+        return a.deadline != b.deadline ? a.deadline < b.deadline : a.seq < b.seq;
+    }
+};
+
+// Keys that do not fit a uint64_t, and the ends of the uint64_t range that
+// used to be taken by the sentinels.
+void testKeyTypes() {
+    SkipListMap<Deadline, int, DeadlineLess> jobs;
+    int bad = 0;
+    for (int i = 0; i < 1000; ++i) {
+        if (!jobs.add(Deadline{ uint64_t(i % 10), uint64_t(i) }, i)) bad++;
+    }
+    if (jobs.add(Deadline{ 3, 3 }, -1)) bad++; // same deadline and seq
+    if (!jobs.contains(Deadline{ 9, 999 }) || jobs.contains(Deadline{ 9, 1000 })) bad++;
+    int last = -1;
+    for (int n = 0; std::optional<int> job = jobs.popMin(); ++n) {
+        // deadline 0 jobs (0, 10, 20, ...) first, then deadline 1 ...
+        int expected = (n % 100) * 10 + n / 100;
+        if (*job != expected) bad++;
+        last = *job;
+    }
+    if (last != 999) bad++;
+
+    SkipList<int> ends;
+    if (!ends.add(0, 1) || !ends.add(UINT64_MAX, 2)) bad++;
+    if (!ends.contains(0) || !ends.contains(UINT64_MAX) || ends.get(UINT64_MAX) != 2) bad++;
+    if (ends.popMin() != 1 || ends.popMin() != 2 || !ends.empty()) bad++;
+
+    List<int> list;
+    if (list.contains(0)) bad++;
+    std::cout << "Key type test complete, failures: " << bad << "\n";
+}
+
+// Equal keys from several threads: nothing is lost, and each thread's items
+// with the same key come out in the order it added them.
+void testDuplicateKeys() {
+    const int threadCount = 4;
+    const int perThread = 20000;
+    const int keys = 16;
+    MultiSkipList<int> pq;
+    int bad = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < perThread; ++i)
+                pq.add(uint64_t(i % keys), t * perThread + i);
+        });
+    }
+    for (auto& th : threads) th.join();
+    if (pq.size() != size_t(threadCount) * perThread || pq.exactSize() != pq.size()) bad++;
+
+    if (!pq.remove(3) || !pq.contains(3) || pq.get(keys) || pq.remove(keys)) bad++;
+    int prevValue = -1;
+    size_t threes = pq.rangeScan(3, 3, [&](uint64_t key, int value) {
+        if (key != 3 || (value / perThread == prevValue / perThread && value <= prevValue)) bad++;
+        prevValue = value;
+    });
+    if (threes != size_t(threadCount) * perThread / keys - 1) bad++;
+    int count = 1; // the one removed above
+    std::vector<int> last(size_t(threadCount) * keys, -1);
+    int prevKey = 0;
+    while (std::optional<int> v = pq.popMin()) {
+        int t = *v / perThread, i = *v % perThread, key = i % keys;
+        if (key < prevKey) bad++;
+        if (i <= last[size_t(t) * keys + key]) bad++;
+        last[size_t(t) * keys + key] = i;
+        prevKey = key;
+        count++;
+    }
+    if (count != threadCount * perThread) bad++;
+    if (pq.size() != 0) bad++;
+    std::cout << "Duplicate key test complete, failures: " << bad << "\n";
+}
+
+// Adds, removes and updateKeys on a few keys with many copies each, from
+// every thread: a remove's or move's cleanup must unlink its own node even
+// when a copy with a smaller seq became visible in front of it meanwhile.
+template <typename Queue>
+void testDuplicateChurn(const char* name, int threadCount, int opsPerThread, int keys) {
+    Queue pq;
+    int bad = 0;
+    std::atomic<int> net{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int i = 0; i < opsPerThread; ++i) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                uint64_t key = x % keys;
+                switch (x >> 32 & 3) {
+                case 0:
+                case 1:
+                    pq.add(key, t);
+                    net.fetch_add(1);
+                    break;
+                case 2:
+                    if (pq.remove(key))
+                        net.fetch_sub(1);
+                    break;
+                default:
+                    pq.updateKey(key, (key + 1) % keys);
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    if (pq.linkedMarked() != 0) bad++;
+    if (pq.exactSize() != size_t(net.load()) || pq.size() != pq.exactSize()) bad++;
+    std::cout << "Duplicate key churn [" << name << "] " << threadCount << " threads on " << keys << " keys, failures: " << bad << "\n";
+}
+
+// Producers and consumers at once: every key added comes out of popMin
+// exactly once. Then, single threaded, the rank error of the two-choice pop.
+template <typename Queue>
+void testMultiQueue(const char* name, int threadCount, int keysPerThread, MultiQueueInsert insert = MultiQueueInsert::Random) {
+    Queue q(MULTIQUEUE_SHARDS_PER_THREAD * threadCount, insert);
+    int total = threadCount * keysPerThread;
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> producing{ threadCount };
+    std::atomic<int> popped{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < keysPerThread; ++i)
+                q.add(uint64_t(i) * threadCount + t, i * threadCount + t);
+            producing.fetch_sub(1);
+        });
+        threads.emplace_back([&]() {
+            while (true) {
+                bool last = producing.load() == 0;
+                std::optional<int> val = q.popMin();
+                if (val) {
+                    seen[*val].fetch_add(1);
+                    popped.fetch_add(1);
+                }
+                else if (last) {
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    int bad = 0;
+    for (auto& n : seen)
+        if (n.load() != 1) bad++;
+    if (popped.load() != total || !q.empty() || q.size() != 0) bad++;
+
+    for (int i = 0; i < total; ++i)
+        q.add(i, i);
+    std::vector<bool> out(total, false);
+    int lowest = 0;
+    long long rankSum = 0;
+    int rankMax = 0;
+    while (std::optional<int> val = q.popMin()) {
+        int rank = 0;
+        for (int k = lowest; k < *val; ++k)
+            if (!out[k]) ++rank;
+        out[*val] = true;
+        while (lowest < total && out[lowest]) ++lowest;
+        rankSum += rank;
+        rankMax = std::max(rankMax, rank);
+    }
+    std::cout << "MultiQueue test [" << name << "] " << q.shardCount() << " shards in " << q.groupCount() << " groups, failures: " << bad
+        << ", rank error mean " << double(rankSum) / total << ", max " << rankMax << "\n";
+}
+
+// Job scheduler loop: every thread schedules a job at a random time and
+// runs the earliest it can get, opsPerThread times. The queue is passed in
+// so each caller can configure it.
+template <typename Queue>
+void benchmarkScheduler(const char* name, Queue& q, int threadCount, int opsPerThread) {
+    using Clock = std::chrono::steady_clock;
+    for (int i = 0; i < 1024; ++i)
+        q.add(uint64_t(i) << 20, i); // backlog, so pops rarely find it empty
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int i = 0; i < opsPerThread; ++i) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                q.add(x >> 4, i);
+                q.popMin();
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << name << ": scheduler add+popMin " << ms << " ms, "
+        << 2.0 * threadCount * opsPerThread / ms / 1000.0 << " Mops/s (" << threadCount << " threads)\n";
+}
+
+// Bursty producers and consumers: each producer adds keys in decreasing
+// order, so every add is a new minimum, while consumers pop. Every item
+// must come out exactly once; prints the time and how many adds were
+// handed over without touching the list (Queue uses ThreadStats). With
+// eliminates, none handed over counts as a failure.
+template <typename Queue>
+void testElimination(const char* name, int pairs, int keysPerThread, bool eliminates) {
+    using Clock = std::chrono::steady_clock;
+    Queue q;
+    int total = pairs * keysPerThread;
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> producing{ pairs };
+    StatsSnapshot before = Queue::stats();
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < pairs; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = keysPerThread - 1; i >= 0; --i)
+                q.add(uint64_t(i) * pairs + t, i * pairs + t);
+            producing.fetch_sub(1);
+        });
+        threads.emplace_back([&]() {
+            while (true) {
+                bool last = producing.load() == 0;
+                if (std::optional<int> val = q.popMin())
+                    seen[*val].fetch_add(1);
+                else if (last)
+                    break;
+                else
+                    std::this_thread::yield(); // let a producer with an offer run
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    StatsSnapshot d = Queue::stats() - before;
+    int bad = 0;
+    for (auto& n : seen)
+        if (n.load() != 1) bad++;
+    if (!q.empty()) bad++;
+    if (eliminates && d[STAT_ELIMINATED] == 0) bad++; // every add is a new minimum, some must be handed over
+    std::cout << "Elimination test [" << name << "] " << ms << " ms, " << d[STAT_ELIMINATED] << " of " << total
+        << " adds eliminated, failures: " << bad << "\n";
+}
+
+// Consumers in popMinWait: bursts of adds with idle gaps between them.
+// Every item must arrive, and during a gap the waiting consumers should
+// use next to no CPU (std::clock is process CPU time).
+template <typename Queue>
+void testPopMinWait(const char* name, int consumers, int bursts, int burstSize) {
+    Queue q;
+    std::atomic<bool> done{ false };
+    std::atomic<int> received{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < consumers; ++t) {
+        threads.emplace_back([&]() {
+            while (!done.load()) {
+                if (q.popMinWait(std::chrono::milliseconds(50)))
+                    received.fetch_add(1);
+            }
+        });
+    }
+    double idleCpuMs = 0;
+    for (int b = 0; b < bursts; ++b) {
+        std::clock_t cpu = std::clock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        idleCpuMs += 1000.0 * double(std::clock() - cpu) / CLOCKS_PER_SEC;
+        for (int i = 0; i < burstSize; ++i)
+            q.add(uint64_t(b) * burstSize + i, i);
+    }
+    while (received.load() < bursts * burstSize && !q.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    done.store(true);
+    for (auto& th : threads) th.join();
+    int bad = received.load() != bursts * burstSize ? 1 : 0;
+    std::cout << "popMinWait test [" << name << "] " << consumers << " consumers, CPU while idle "
+        << idleCpuMs / bursts << " ms per 40 ms gap, failures: " << bad << "\n";
+}
+
+// Threads keep moving their own items between keys of their own residue
+// class, so whether a move succeeds is known in advance: it fails exactly
+// when the thread already has an item at the new key. Afterwards every item
+// must be at its last key, once. Then the MultiSkipList version on equal keys.
+template <typename Queue>
+void testUpdateKey(const char* name, int threadCount, int itemsPerThread, int movesPerThread) {
+    Queue q;
+    const uint64_t slots = uint64_t(itemsPerThread) * 4; // keys per thread
+    std::atomic<int> bad{ 0 };
+    std::vector<std::vector<uint64_t>> keyOf(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            std::vector<uint64_t>& key = keyOf[t];
+            std::vector<int> at(slots, -1);
+            for (int i = 0; i < itemsPerThread; ++i) {
+                key.push_back(uint64_t(i) * 4);
+                at[key[i]] = i;
+                q.add(key[i] * threadCount + t, t * itemsPerThread + i);
+            }
+            uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int n = 0; n < movesPerThread; ++n) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                int i = int(x % itemsPerThread);
+                // mostly short moves, the reprioritising case
+                uint64_t to = (x >> 32) % 8 ? (key[i] + slots - 8 + (x >> 40) % 17) % slots : (x >> 32) % slots;
+                bool moved = q.updateKey(key[i] * threadCount + t, to * threadCount + t);
+                if (moved != (at[to] == -1)) bad++;
+                if (moved) {
+                    at[key[i]] = -1;
+                    at[to] = i;
+                    key[i] = to;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    for (int t = 0; t < threadCount; ++t)
+        for (int i = 0; i < itemsPerThread; ++i) {
+            std::optional<int> val = q.get(keyOf[t][i] * threadCount + t);
+            if (!val || *val != t * itemsPerThread + i) bad++;
+        }
+    if (q.exactSize() != size_t(threadCount) * itemsPerThread || q.size() != q.exactSize()) bad++;
+
+    MultiSkipList<int> multi;
+    multi.add(1, 10);
+    multi.add(1, 11);
+    multi.add(2, 20);
+    if (!multi.updateKey(1, 2) || multi.updateKey(5, 1)) bad++;
+    for (int expected : { 11, 20, 10 }) {
+        std::optional<int> val = multi.popMin();
+        if (!val || *val != expected) bad++;
+    }
+    std::cout << "updateKey test [" << name << "] " << threadCount * movesPerThread << " moves, failures: " << bad.load() << "\n";
+}
+
+// Schedulers add timers up to `horizon` ticks ahead and cancel every third
+// one while a dispatcher advances the clock `step` ticks at a time. Every
+// timer not cancelled must run exactly once, no earlier than its deadline
+// and within one step after it, or after the schedule call returned if
+// the deadline had passed by then; cancelled ones never.
+template <typename Scheduler>
+void testTimers(const char* name, int threadCount, int timersPerThread, uint64_t horizon, uint64_t step) {
+    Scheduler timers;
+    int total = threadCount * timersPerThread;
+    std::vector<uint64_t> deadline(total);
+    std::vector<std::atomic<int>> runs(total);
+    std::vector<std::atomic<uint64_t>> ranAt(total);
+    std::vector<uint64_t> scheduledAt(total);
+    std::vector<char> cancelled(total, 0);
+    std::atomic<int> scheduling{ threadCount };
+    std::atomic<size_t> farPeak{ 0 };
+    std::thread dispatcher([&]() {
+        uint64_t now = 0;
+        while (scheduling.load() > 0 || timers.pending() > 0) {
+            now += step;
+            timers.runExpired(now, [&](int i) {
+                runs[i].fetch_add(1);
+                ranAt[i].store(now);
+            });
+            size_t far = timers.farPending();
+            if (far > farPeak.load()) farPeak.store(far);
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int n = 0; n < timersPerThread; ++n) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                int i = t * timersPerThread + n;
+                deadline[i] = timers.now() + x % horizon;
+                TimerHandle h = timers.schedule(deadline[i], i);
+                scheduledAt[i] = timers.now();
+                if (n % 3 == 0)
+                    cancelled[i] = timers.cancel(h);
+            }
+            scheduling.fetch_sub(1);
+        });
+    }
+    for (auto& th : threads) th.join();
+    dispatcher.join();
+    int bad = 0;
+    for (int i = 0; i < total; ++i) {
+        int expected = cancelled[i] ? 0 : 1;
+        if (runs[i].load() != expected) bad++;
+        else if (expected && (ranAt[i].load() < deadline[i] || ranAt[i].load() > std::max(deadline[i], scheduledAt[i]) + 2 * step)) bad++;
+    }
+    std::cout << "Timer test [" << name << "] " << total << " timers over " << horizon << " ticks, peak "
+        << farPeak.load() << " in the skiplist tier, failures: " << bad << "\n";
+}
+
+// Add/remove churn on a few hot keys, then prints what the find and CAS
+// paths did. Queue must use ThreadStats; the counts are the delta over
+// the run.
+template <typename Queue>
+void reportContention(const char* name, int threadCount, int keys, int opsPerThread) {
+    Queue q;
+    StatsSnapshot before = Queue::stats();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x9E3779B97F4A7C15ull * (t + 1);
+            for (int i = 0; i < opsPerThread; ++i) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                uint64_t key = x % keys;
+                if (x & (1ull << 40))
+                    q.add(key, int(i));
+                else
+                    q.remove(key);
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    StatsSnapshot d = Queue::stats() - before;
+    std::cout << "Contention [" << name << "] " << threadCount << " threads, " << keys << " keys: " << d << "\n";
+    if (d[STAT_FIND])
+        std::cout << "  restarts per find " << double(d[STAT_FIND_RESTART]) / d[STAT_FIND]
+                  << ", steps per find " << double(d[STAT_FIND_STEP]) / d[STAT_FIND] << "\n";
+}
+
+// Every linearizable structure and reclaimer through Lincheck.h; returns
+// the number of failed rounds.
+// Lincheck factories: spray popMin tuned for 4 threads; 4 shards.
+template <typename Queue>
+std::unique_ptr<Queue> makeRelaxed() {
+    auto q = std::make_unique<Queue>();
+    q->setRelaxedPopMin(4);
+    return q;
+}
+template <typename Queue>
+std::unique_ptr<Queue> makeSharded() { return std::make_unique<Queue>(4); }
+
+int runLincheck(int rounds) {
+    int failed = 0;
+    failed += lincheck<SkipList<int, EpochManager>>("SkipList, EpochManager", rounds);
+    failed += lincheck<SkipList<int, HazardPointerManager>>("SkipList, HazardPointerManager", rounds);
+    failed += lincheck<SkipList<int, EpochManager, SlabNodeAllocator>>("SkipList, SlabNodeAllocator", rounds);
+    failed += lincheck<List<int, EpochManager>>("List, EpochManager", rounds);
+    failed += lincheck<List<int, HazardPointerManager>>("List, HazardPointerManager", rounds);
+    failed += lincheck<EliminationSkipList<int, EpochManager>>("EliminationSkipList, EpochManager", rounds);
+    failed += lincheck<EliminationSkipList<int, HazardPointerManager>>("EliminationSkipList, HazardPointerManager", rounds);
+    // 3 keys, so that equal keys and probes meet
+    failed += lincheck<MultiSkipList<int, EpochManager>, LinMultiModel>("MultiSkipList, EpochManager", rounds, {}, 3, 5, 3);
+    failed += lincheck<MultiSkipList<int, HazardPointerManager>, LinMultiModel>("MultiSkipList, HazardPointerManager", rounds, {}, 3, 5, 3);
+    failed += lincheck<SkipList<int, EpochManager>, LinAnyPopModel>("SkipList relaxed popMin, EpochManager", rounds,
+        makeRelaxed<SkipList<int, EpochManager>>);
+    failed += lincheck<SkipList<int, HazardPointerManager>, LinAnyPopModel>("SkipList relaxed popMin, HazardPointerManager", rounds,
+        makeRelaxed<SkipList<int, HazardPointerManager>>);
+    failed += lincheck<MultiQueue<int, EpochManager>, LinPoolModel>("MultiQueue, EpochManager", rounds,
+        makeSharded<MultiQueue<int, EpochManager>>);
+    failed += lincheck<MultiQueue<int, HazardPointerManager>, LinPoolModel>("MultiQueue, HazardPointerManager", rounds,
+        makeSharded<MultiQueue<int, HazardPointerManager>>);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        BenchConfig cfg = defaultBenchConfig();
+        if (!parseBenchArgs(argc - 2, argv + 2, cfg)) {
+            std::cout << "usage: " << argv[0] << " " << benchUsage();
+            return 1;
+        }
+        runBenchmarks(cfg);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--lincheck") {
+        int rounds = argc > 2 ? std::atoi(argv[2]) : 20000;
+        return runLincheck(rounds) == 0 ? 0 : 1;
+    }
+
     const int THREADS = 4;
     std::vector<std::thread> threads;
 
@@ -73,8 +1058,7 @@ int main() {
     }
 
     for (auto& th : threads) th.join();
-    int* val = nullptr;
-    while ((val = pq.popMin()) != nullptr) {
+    while (std::optional<int> val = pq.popMin()) {
         std::cout << *val << " ";
     }
     std::cout << std::endl;
@@ -93,9 +1077,7 @@ int main() {
             for (int i = t * OPS_PER_THREAD; i < (t + 1) * OPS_PER_THREAD; ++i) {
                 list.add(i, i); // insert key=i, value=i
                 auto v = list.get(i);
-                if (v)
-                    std::cout << *v << "\n";
-                if (v == nullptr || *v != i) {
+                if (!v || *v != i) {
                     std::cout << "[THREAD " << t << "] GET FAILED at " << i << "\n";
                 }
 
@@ -143,11 +1125,7 @@ int main() {
     std::cout << "Multiple threads tried to remove same node: " << removeFailures << "\n";
 
     // Final sanity check: list should be empty
-    int remaining = 0;
-    for (int i = 0; i < THREAD_COUNT * OPS_PER_THREAD; ++i) {
-        if (list.contains(i)) remaining++;
-    }
-    std::cout << "Remaining items in list: " << remaining << "\n";
+    std::cout << "Remaining items in list: " << list.size() << " (walked: " << list.exactSize() << ")\n";
     
     const int TOTAL_NODES = 2000;
     
@@ -173,7 +1151,72 @@ int main() {
         }
     }
     std::cout << "PopMin test complete. Total nodes popped: " << results.size() << "\n";
+    testKeyTypes();
+    testDuplicateKeys();
+    testDuplicateChurn<MultiSkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 200000, 4);
+    testDuplicateChurn<MultiSkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 200000, 4);
+    testRangeScan<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT - 1, 4096);
+    testRangeScan<SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT - 1, 4096);
+    testRangeScan<List<int, EpochManager>>("List, EpochManager", THREAD_COUNT - 1, 512);
+    testRangeScan<List<int, HazardPointerManager>>("List, HazardPointerManager", THREAD_COUNT - 1, 512);
+    testScanCallbacks<SkipList<int, EpochManager>, EliminationSkipList<int, EpochManager>>("EpochManager", THREAD_COUNT - 1, 4096);
+    testScanCallbacks<SkipList<int, HazardPointerManager>, EliminationSkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT - 1, 4096);
+    testFinger<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 50000);
+    testFinger<SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 50000);
+    testHashMap<LockFreeHashMap<int, EpochManager>>("EpochManager", THREAD_COUNT, 50000);
+    testHashMap<LockFreeHashMap<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 50000);
+    testMultiQueue<MultiQueue<int, EpochManager>>("EpochManager", THREAD_COUNT, 20000);
+    testMultiQueue<MultiQueue<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 20000);
+    std::cout << "NUMA nodes: " << numaNodeCount() << ", main thread on node " << currentNumaNode() << "\n";
+    testMultiQueue<MultiQueue<int, EpochManager, NumaNodeAllocator>>("NumaLocal + NumaNodeAllocator", THREAD_COUNT, 20000, MultiQueueInsert::NumaLocal);
+    runLincheck(500);
+    testUpdateKey<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 2000, 50000);
+    testUpdateKey<SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 2000, 50000);
+    testSnapshot<SkipList<int, EpochManager>>("EpochManager", 200000);
+    testSnapshot<SkipList<int, HazardPointerManager>>("HazardPointerManager", 200000);
+    testGetMany<SkipList<int, EpochManager>>("EpochManager", 200000, 200000);
+    testGetMany<SkipList<int, HazardPointerManager>>("HazardPointerManager", 200000, 200000);
+    testTimers<TimerScheduler<int, EpochManager>>("EpochManager", THREAD_COUNT - 1, 20000, 1 << 20, 64);
+    testTimers<TimerScheduler<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT - 1, 20000, 1 << 14, 16);
+    testPopMinWait<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 10, 5000);
+    testPopMinWait<SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 10, 5000);
+    testElimination<SkipList<int, EpochManager, HeapNodeAllocator, MAX_LEVEL, 1, ThreadStats<>>>("SkipList", THREAD_COUNT / 2, 50000, false);
+    testElimination<EliminationSkipList<int, EpochManager, HeapNodeAllocator, MAX_LEVEL, 1, ThreadStats<>>>("EliminationSkipList", THREAD_COUNT / 2, 50000, true);
+    testElimination<EliminationSkipList<int, HazardPointerManager, HeapNodeAllocator, MAX_LEVEL, 1, ThreadStats<>>>("EliminationSkipList, HazardPointerManager", THREAD_COUNT / 2, 50000, true);
 
+    benchmarkQueue<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, EpochManager, SlabNodeAllocator>>("EpochManager + SlabNodeAllocator", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, EpochManager, CacheAlignedNodeAllocator>>("EpochManager + CacheAlignedNodeAllocator", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, EpochManager, NumaNodeAllocator>>("EpochManager + NumaNodeAllocator", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, EpochManager, HeapNodeAllocator, 10, 2>>("EpochManager, p = 0.25, 11 levels", THREAD_COUNT, 20000);
+    benchmarkQueue<SkipList<int, EpochManager>>("EpochManager, relaxed popMin", THREAD_COUNT, 20000, THREAD_COUNT);
+    benchmarkQueue<SkipList<int, HazardPointerManager>>("HazardPointerManager, relaxed popMin", THREAD_COUNT, 20000, THREAD_COUNT);
+    benchmarkBulkLoad<SkipList<int, EpochManager>>("EpochManager", 1000000);
+    benchmarkBulkLoad<SkipList<int, HazardPointerManager>>("HazardPointerManager", 1000000);
+    benchmarkFinger<SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 100000);
+    benchmarkScan<SkipList<int, EpochManager>>("EpochManager", 1000000);
+    benchmarkScan<SkipList<int, HazardPointerManager>>("HazardPointerManager", 1000000);
+    benchmarkLookup<LockFreeHashMap<int, EpochManager>, SkipList<int, EpochManager>>("EpochManager", THREAD_COUNT, 500000);
+    benchmarkLookup<LockFreeHashMap<int, HazardPointerManager>, SkipList<int, HazardPointerManager>>("HazardPointerManager", THREAD_COUNT, 500000);
+    measureRankError<SkipList<int, EpochManager>>("EpochManager", 8, 20000);
+    measureRankError<SkipList<int, EpochManager>>("EpochManager", 32, 20000);
+    {
+        SkipList<int, EpochManager> strict;
+        benchmarkScheduler("SkipList, strict popMin", strict, THREAD_COUNT, 200000);
+        SkipList<int, EpochManager> relaxed;
+        relaxed.setRelaxedPopMin(THREAD_COUNT);
+        benchmarkScheduler("SkipList, relaxed popMin", relaxed, THREAD_COUNT, 200000);
+        MultiQueue<int, EpochManager> multi(MULTIQUEUE_SHARDS_PER_THREAD * THREAD_COUNT);
+        benchmarkScheduler("MultiQueue", multi, THREAD_COUNT, 200000);
+        MultiQueue<int, EpochManager> sticky(MULTIQUEUE_SHARDS_PER_THREAD * THREAD_COUNT, MultiQueueInsert::Sticky);
+        benchmarkScheduler("MultiQueue, sticky adds", sticky, THREAD_COUNT, 200000);
+        MultiQueue<int, EpochManager, NumaNodeAllocator> local(MULTIQUEUE_SHARDS_PER_THREAD * THREAD_COUNT, MultiQueueInsert::NumaLocal);
+        benchmarkScheduler("MultiQueue, NUMA-local shards", local, THREAD_COUNT, 200000);
+    }
+    reportContention<SkipList<int, EpochManager, HeapNodeAllocator, MAX_LEVEL, 1, ThreadStats<>>>("SkipList, EpochManager", THREAD_COUNT, 64, 200000);
+    reportContention<SkipList<int, HazardPointerManager, HeapNodeAllocator, MAX_LEVEL, 1, ThreadStats<>>>("SkipList, HazardPointerManager", THREAD_COUNT, 64, 200000);
+    reportContention<List<int, EpochManager, HeapNodeAllocator, ThreadStats<struct ListStats>>>("List, EpochManager", THREAD_COUNT, 64, 200000);
 
     return 0;
 }
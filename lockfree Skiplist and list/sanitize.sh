@@ -0,0 +1,30 @@
+#!/bin/sh
+# Builds the program under ThreadSanitizer, AddressSanitizer and
+# UndefinedBehaviorSanitizer and runs the normal checks and --lincheck in
+# each; stops at the first failure. Usage: ./sanitize.sh [rounds]
+# (--lincheck rounds, 2000 by default). CXX picks the compiler (g++ or
+# clang++), OUT the build directory. The ThreadSanitizer run is the slow
+# one, several minutes on a small machine.
+set -e
+cd "$(dirname "$0")"
+CXX=${CXX:-g++}
+OUT=${OUT:-sanitize-build}
+ROUNDS=${1:-2000}
+mkdir -p "$OUT"
+
+for san in thread address undefined; do
+	bin="$OUT/lockfree-$san"
+	echo "== -fsanitize=$san"
+	"$CXX" -std=c++17 -O1 -g -pthread -fno-omit-frame-pointer -fsanitize=$san -fno-sanitize-recover=all \
+		*.cpp -o "$bin"
+	TSAN_OPTIONS="halt_on_error=1 second_deadlock_stack=1" \
+	ASAN_OPTIONS="detect_leaks=1:halt_on_error=1" \
+	UBSAN_OPTIONS="print_stacktrace=1" \
+		"$bin" > "$bin.log"
+	if grep -q "failures: [1-9]" "$bin.log"; then
+		grep "failures: [1-9]" "$bin.log"
+		exit 1
+	fi
+	"$bin" --lincheck "$ROUNDS"
+done
+echo "all sanitizer runs passed"